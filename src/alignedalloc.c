@@ -0,0 +1,45 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "constants.h"
+#include "alignedalloc.h"
+
+static int isHugePagesEnabled = FALSE;
+
+void setHugePages(int isEnabled) {
+    isHugePagesEnabled = isEnabled;
+}
+
+int hugePagesEnabled(void) {
+    return isHugePagesEnabled;
+}
+
+void *allocAligned(size_t size) {
+    int isHuge = isHugePagesEnabled && size >= HUGE_PAGE_SIZE;
+    void *pointer;
+    if (posix_memalign(&pointer, isHuge ? HUGE_PAGE_SIZE : ALLOC_ALIGNMENT, size) != 0) {
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (isHuge) {
+        // only advice, the kernel may still use small pages; the tail past the last huge page is left out
+        madvise(pointer, size & ~(size_t) (HUGE_PAGE_SIZE - 1), MADV_HUGEPAGE);
+    }
+#endif
+    return pointer;
+}
+
+void *allocAlignedZero(size_t size) {
+    void *pointer = allocAligned(size);
+    if (pointer) {
+        memset(pointer, 0, size);
+    }
+    return pointer;
+}
+
+void freeAligned(void *pointer) {
+    free(pointer);
+}
@@ -0,0 +1,26 @@
+#ifndef RAYCASTING_ALIGNEDALLOC_H
+#define RAYCASTING_ALIGNEDALLOC_H
+
+#include <stddef.h>
+
+// start of every aligned block: a full cache line, and room for AVX-512 wide stores
+#define ALLOC_ALIGNMENT 64
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Allocation of the big buffers walked by the renderer: frame buffers, rays, textures.
+// With huge pages on, blocks of a huge page or more are aligned to it and advised to the kernel
+// for transparent huge pages, fewer TLB misses for the column strided writes. Off by default,
+// set it before creating the world and the raycasters.
+void setHugePages(int isEnabled);
+
+int hugePagesEnabled(void);
+
+// ALLOC_ALIGNMENT aligned memory, released with freeAligned(); NULL when out of memory
+void *allocAligned(size_t size);
+
+// zero filled allocAligned()
+void *allocAlignedZero(size_t size);
+
+void freeAligned(void *pointer);
+
+#endif //RAYCASTING_ALIGNEDALLOC_H
@@ -0,0 +1,45 @@
+#include <stddef.h>
+
+#include "alloccount.h"
+
+static long numAllocations;
+
+void *__real_malloc(size_t size);
+
+void *__real_calloc(size_t count, size_t size);
+
+void *__real_realloc(void *pointer, size_t size);
+
+int __real_posix_memalign(void **pointer, size_t alignment, size_t size);
+
+void *__real_aligned_alloc(size_t alignment, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    __sync_fetch_and_add(&numAllocations, 1);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    __sync_fetch_and_add(&numAllocations, 1);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    __sync_fetch_and_add(&numAllocations, 1);
+    return __real_realloc(pointer, size);
+}
+
+// allocAligned() goes through posix_memalign
+int __wrap_posix_memalign(void **pointer, size_t alignment, size_t size) {
+    __sync_fetch_and_add(&numAllocations, 1);
+    return __real_posix_memalign(pointer, alignment, size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+    __sync_fetch_and_add(&numAllocations, 1);
+    return __real_aligned_alloc(alignment, size);
+}
+
+long heapAllocationCount(void) {
+    return __sync_fetch_and_add(&numAllocations, 0);
+}
@@ -0,0 +1,12 @@
+#ifndef RAYCASTING_ALLOCCOUNT_H
+#define RAYCASTING_ALLOCCOUNT_H
+
+// Heap allocation counter, for checking that a loop does not allocate. Only for programs linked
+// with -Wl,--wrap= for malloc, calloc, realloc, posix_memalign and aligned_alloc, which defines
+// RAYCASTING_ALLOC_COUNT in the build; it counts the calls of the program and the raycaster
+// library, not those inside libc.
+
+// malloc, calloc, realloc, posix_memalign and aligned_alloc calls so far
+long heapAllocationCount(void);
+
+#endif //RAYCASTING_ALLOCCOUNT_H
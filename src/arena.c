@@ -0,0 +1,69 @@
+#include <stdlib.h>
+
+#include "constants.h"
+#include "arena.h"
+#include "profiler.h"
+
+#define ARENA_ALIGNMENT 16
+
+static struct Arena threadArenas[MAX_ARENA_THREADS];
+static int numThreadArenas;
+static __thread struct Arena *currentThreadArena;
+static __thread int hasNoThreadArena; // set once creating it failed, so a thread takes a single slot
+
+int initArena(struct Arena *arena, size_t size, int kind) {
+    arena->base = malloc(size);
+    arena->size = arena->base ? size : 0;
+    arena->used = 0;
+    arena->highWater = 0;
+    arena->kind = kind;
+    return arena->base != NULL;
+}
+
+void freeArena(struct Arena *arena) {
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+void *arenaAlloc(struct Arena *arena, size_t size) {
+    size_t offset = (arena->used + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+    if (offset > arena->size || size > arena->size - offset) {
+        return NULL;
+    }
+    arena->used = offset + size;
+    if (arena->used > arena->highWater) {
+        arena->highWater = arena->used;
+    }
+    return arena->base + offset;
+}
+
+size_t arenaMark(const struct Arena *arena) {
+    return arena->used;
+}
+
+void arenaRelease(struct Arena *arena, size_t mark) {
+    arena->used = mark;
+    if (mark == 0) {
+        arenaReset(arena);
+    }
+}
+
+void arenaReset(struct Arena *arena) {
+    profileArenaUsage(arena->kind, arena->highWater, arena->size);
+    arena->used = 0;
+    arena->highWater = 0;
+}
+
+struct Arena *threadArena(void) {
+    if (!currentThreadArena && !hasNoThreadArena) {
+        int index = __sync_fetch_and_add(&numThreadArenas, 1);
+        if (index >= MAX_ARENA_THREADS || !initArena(&threadArenas[index], THREAD_ARENA_SIZE, PROFILE_ARENA_THREAD)) {
+            hasNoThreadArena = TRUE;
+            return NULL;
+        }
+        currentThreadArena = &threadArenas[index];
+    }
+    return currentThreadArena;
+}
@@ -0,0 +1,38 @@
+#ifndef RAYCASTING_ARENA_H
+#define RAYCASTING_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Linear allocator for transient memory: allocations bump an offset in one block allocated up
+// front and are all dropped at once, by arenaReset() or back to an arenaMark().
+struct Arena {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t highWater; // most bytes used since the last report to the profiler
+    int kind;         // PROFILE_ARENA_*, the profiler keeps the high-water mark per kind
+};
+
+int initArena(struct Arena *arena, size_t size, int kind);
+
+void freeArena(struct Arena *arena);
+
+// 16-byte aligned memory, NULL when the arena is full
+void *arenaAlloc(struct Arena *arena, size_t size);
+
+size_t arenaMark(const struct Arena *arena);
+
+// Frees everything allocated since the mark.
+void arenaRelease(struct Arena *arena, size_t mark);
+
+// Frees everything and reports the high-water mark to the profiler, once per frame.
+void arenaReset(struct Arena *arena);
+
+// Scratch arena of the calling thread, created on first use and kept for the life of the process.
+// Users release what they allocate before returning, with arenaMark() and arenaRelease().
+// NULL when it could not be created, for good on that thread: callers then take a slower path,
+// renderViews() renders the views one at a time, prepareSprites() sorts in the frame arena.
+struct Arena *threadArena(void);
+
+#endif //RAYCASTING_ARENA_H
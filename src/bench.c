@@ -0,0 +1,357 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "raycaster.h"
+#include "upng.h"
+
+// Micro-benchmarks of the caster, the projection and the texture decoder. Every benchmark runs
+// its operation in a loop, the iteration count doubling until a run takes the minimum time, then
+// reports the best of the repetitions in ns per operation, per column for the projection so the
+// numbers hold across resolutions, and, for the ones moving pixels, bytes per second (written
+// frame bytes, decoded image bytes).
+//
+// usage: raycasting_bench [-f filter] [-m seconds] [-r repetitions] [-c cpu] [-i images]
+// -f runs the benchmarks whose name contains the filter only. -c pins the process to a CPU, for
+// stable numbers also keep the frequency fixed and the machine otherwise idle.
+
+#define DEFAULT_MIN_SECONDS 0.2
+#define DEFAULT_REPETITIONS 3
+#define MAX_ITERATIONS (1L << 40)
+#define NUM_PROBES 1024 // mapHasWallAt() points, cycled through
+
+#ifndef RAYCASTING_IMAGES_DIR
+#define RAYCASTING_IMAGES_DIR "images"
+#endif
+
+struct BenchState {
+    struct Raycaster *rc;
+    const void *argument;
+    double bytesPerOp; // 0 when the throughput means nothing
+    int columnsPerOp;  // the time is reported per column when set, for the whole frame operations
+    float sink;        // results of the operations, so none is optimized away
+};
+
+typedef void (*BenchFunction)(struct BenchState *state, long numIterations);
+
+struct BenchOptions {
+    const char *filter;
+    const char *imagesPath;
+    double minSeconds;
+    int numRepetitions;
+    int cpu; // -1 to leave the scheduler alone
+};
+
+struct CastCase {
+    float x;
+    float y;
+    float angle;
+};
+
+struct ImageFile {
+    unsigned char *bytes;
+    unsigned long size;
+};
+
+// from free cells of the stock map: a wall two tiles or less away, or across the map
+static const struct CastCase shortAxisCast = {96, 160, PI};
+static const struct CastCase longAxisCast = {96, 160, 0};
+static const struct CastCase shortDiagonalCast = {96, 160, 3 * PI / 4};
+static const struct CastCase longDiagonalCast = {96, 96, 0.45f};
+
+static const float nearWallDistance = 40;  // taller than the frame, clipped
+static const float farWallDistance = 900;
+
+// a cell of the short wall in the lower right of the stock map, hiding cells on either side
+static const int pvsEditCell[2] = {12, 10};
+
+static double currentSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void benchCastRay(struct BenchState *state, long numIterations) {
+    const struct CastCase *cast = state->argument;
+    struct Raycaster *rc = state->rc;
+    rc->camera.x = cast->x;
+    rc->camera.y = cast->y;
+    rc->camera.angle = cast->angle;
+    for (long i = 0; i < numIterations; ++i) {
+        castRay(rc, cast->angle, 0);
+        state->sink += rc->rays[0].distance;
+    }
+}
+
+// every column hits a wall at the given distance straight ahead
+static void fillRays(struct Raycaster *rc, float distance) {
+    rc->camera.angle = 0;
+    for (int i = 0; i < rc->width; ++i) {
+        struct Ray *ray = &rc->rays[i];
+        memset(ray, 0, sizeof(*ray));
+        ray->distance = distance;
+        ray->wallHitX = i % TILE_SIZE;
+        ray->wasHitVertical = i % 2;
+        ray->wallHitY = i % TILE_SIZE;
+        ray->wallHitContent = 1 + i % NUM_TEXTURES;
+    }
+}
+
+static void benchProjection(struct BenchState *state, long numIterations) {
+    struct Raycaster *rc = state->rc;
+    fillRays(rc, *(const float *) state->argument);
+    beginFrame(rc);
+    for (long i = 0; i < numIterations; ++i) {
+        generate3DProjection(rc);
+        state->sink += rc->colorBuffer[i % rc->width];
+    }
+    state->bytesPerOp = (double) rc->width * rc->height * sizeof(uint32_t);
+    state->columnsPerOp = rc->width;
+}
+
+static void benchClearColorBuffer(struct BenchState *state, long numIterations) {
+    struct Raycaster *rc = state->rc;
+    for (long i = 0; i < numIterations; ++i) {
+        clearColorBuffer(rc, (uint32_t) i);
+        state->sink += rc->colorBuffer[i % rc->width];
+    }
+    state->bytesPerOp = (double) rc->width * rc->height * sizeof(uint32_t);
+}
+
+static void benchMapHasWallAt(struct BenchState *state, long numIterations) {
+    const struct Map *map = &state->rc->world->map;
+    const float *probes = state->argument; // x, y pairs
+    int numWalls = 0;
+    for (long i = 0; i < numIterations; ++i) {
+        int probe = i % NUM_PROBES;
+        numWalls += mapHasWallAt(map, probes[2 * probe], probes[2 * probe + 1]);
+    }
+    state->sink += numWalls;
+}
+
+static void benchDecodePng(struct BenchState *state, long numIterations) {
+    const struct ImageFile *image = state->argument;
+    for (long i = 0; i < numIterations; ++i) {
+        upng_t *upng = upng_new_from_bytes(image->bytes, image->size);
+        if (upng && upng_decode(upng) == UPNG_EOK) {
+            state->bytesPerOp = upng_get_size(upng);
+            state->sink += upng_get_buffer(upng)[0];
+        }
+        upng_free(upng);
+    }
+}
+
+// removes or puts back the wall, then refreshes every stale set: the average of an opening and a closing
+static void benchPvsEdit(struct BenchState *state, long numIterations) {
+    struct World *world = state->rc->world;
+    const int *cell = state->argument;
+    struct Pvs *pvs = &world->pvs;
+    for (long i = 0; world->hasPvs && i < numIterations; ++i) {
+        int isWall = mapIsSolidCell(&world->map, cell[0], cell[1]);
+        worldEditCell(world, cell[0], cell[1], isWall ? 0 : 1);
+        while (pvs->numStale > 0 || pvs->rebuildCell >= 0) {
+            state->sink += refreshPvs(pvs, world->map.cells, UINT64_MAX);
+        }
+    }
+}
+
+// one refresh of the per-update budget, editing the wall again whenever no set is stale
+static void benchPvsRefresh(struct BenchState *state, long numIterations) {
+    struct World *world = state->rc->world;
+    const int *cell = state->argument;
+    struct Pvs *pvs = &world->pvs;
+    for (long i = 0; world->hasPvs && i < numIterations; ++i) {
+        if (pvs->numStale == 0 && pvs->rebuildCell < 0) {
+            int isWall = mapIsSolidCell(&world->map, cell[0], cell[1]);
+            worldEditCell(world, cell[0], cell[1], isWall ? 0 : 1);
+        }
+        state->sink += refreshPvs(pvs, world->map.cells, PVS_REFRESH_BUDGET_NS);
+    }
+}
+
+static int isSelected(const struct BenchOptions *options, const char *name) {
+    return !options->filter || strstr(name, options->filter);
+}
+
+// Runs a benchmark as the options ask and prints its line, unless the filter skips it.
+static void runBenchmark(const struct BenchOptions *options, struct BenchState *state, const char *name,
+                         BenchFunction function, const void *argument) {
+    if (!isSelected(options, name)) {
+        return;
+    }
+    state->argument = argument;
+    state->bytesPerOp = 0;
+    state->columnsPerOp = 0;
+
+    long numIterations = 1;
+    double seconds = 0;
+    for (;;) {
+        double start = currentSeconds();
+        function(state, numIterations);
+        seconds = currentSeconds() - start;
+        if (seconds >= options->minSeconds || numIterations >= MAX_ITERATIONS) {
+            break;
+        }
+        // aim a little past the minimum time, without growing more than 100 times at once
+        long nextIterations = seconds > 0 ? (long) (numIterations * 1.4 * options->minSeconds / seconds) : 0;
+        nextIterations = nextIterations < 2 * numIterations ? 2 * numIterations : nextIterations;
+        numIterations = nextIterations > 100 * numIterations ? 100 * numIterations : nextIterations;
+    }
+    double bestSeconds = seconds;
+    for (int i = 1; i < options->numRepetitions; ++i) {
+        double start = currentSeconds();
+        function(state, numIterations);
+        seconds = currentSeconds() - start;
+        bestSeconds = seconds < bestSeconds ? seconds : bestSeconds;
+    }
+
+    double nsPerOp = bestSeconds * 1e9 / numIterations;
+    if (state->columnsPerOp > 0) {
+        printf("%-36s %12ld %11.2f ns/col", name, numIterations, nsPerOp / state->columnsPerOp);
+    } else {
+        printf("%-36s %12ld %12.1f ns/op", name, numIterations, nsPerOp);
+    }
+    if (state->bytesPerOp > 0) {
+        printf(" %10.1f MB/s", state->bytesPerOp / nsPerOp * 1e9 / (1024 * 1024));
+    }
+    printf("\n");
+}
+
+static int isPngFile(const struct dirent *entry) {
+    size_t length = strlen(entry->d_name);
+    return length > 4 && strcmp(entry->d_name + length - 4, ".png") == 0;
+}
+
+static int loadFile(const char *path, struct ImageFile *image) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return FALSE;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    image->bytes = size > 0 ? malloc(size) : NULL;
+    image->size = size > 0 ? size : 0;
+    int isRead = image->bytes && fread(image->bytes, 1, image->size, file) == image->size;
+    fclose(file);
+    return isRead;
+}
+
+// decodes every PNG of the directory, in name order
+static void runDecodeBenchmarks(const struct BenchOptions *options, struct BenchState *state) {
+    struct dirent **entries;
+    int numEntries = scandir(options->imagesPath, &entries, isPngFile, alphasort);
+    if (numEntries < 0) {
+        fprintf(stderr, "Error reading %s, skipping upng_decode\n", options->imagesPath);
+        return;
+    }
+    char path[PATH_MAX];
+    char name[sizeof("upng_decode/") + NAME_MAX];
+    for (int i = 0; i < numEntries; ++i) {
+        struct ImageFile image = {NULL, 0};
+        snprintf(name, sizeof(name), "upng_decode/%s", entries[i]->d_name);
+        if (snprintf(path, sizeof(path), "%s/%s", options->imagesPath, entries[i]->d_name) >= (int) sizeof(path)) {
+            fprintf(stderr, "Path too long in %s\n", options->imagesPath);
+        } else if (loadFile(path, &image)) {
+            runBenchmark(options, state, name, benchDecodePng, &image);
+        } else {
+            fprintf(stderr, "Error reading %s\n", path);
+        }
+        free(image.bytes);
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+static int parseOptions(int argc, char *argv[], struct BenchOptions *options) {
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 >= argc) {
+            return FALSE;
+        }
+        if (strcmp(argv[i], "-f") == 0) {
+            options->filter = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0) {
+            options->minSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0) {
+            options->numRepetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            options->cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0) {
+            options->imagesPath = argv[++i];
+        } else {
+            return FALSE;
+        }
+    }
+    return options->minSeconds > 0 && options->numRepetitions > 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct BenchOptions options = {NULL, RAYCASTING_IMAGES_DIR, DEFAULT_MIN_SECONDS, DEFAULT_REPETITIONS, -1};
+    if (!parseOptions(argc, argv, &options)) {
+        fprintf(stderr, "usage: raycasting_bench [-f filter] [-m seconds] [-r repetitions] [-c cpu] [-i images]\n");
+        return 1;
+    }
+    if (options.cpu >= 0) {
+#ifdef CPU_SET
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options.cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            fprintf(stderr, "Error pinning to CPU %d\n", options.cpu);
+            return 1;
+        }
+#else
+        fprintf(stderr, "CPU pinning is not supported here, running unpinned\n");
+#endif
+    }
+
+    struct World *world = createWorld(&defaultMap[0][0], MAP_NUM_COLS, MAP_NUM_ROWS);
+    struct Raycaster *rc = world ? createRaycaster(world, WINDOW_WIDTH, WINDOW_HEIGHT) : NULL;
+    if (!rc) {
+        fprintf(stderr, "Error creating the raycaster\n");
+        return 1;
+    }
+    // a fixed spread over the map and a bit outside of it
+    static float probes[2 * NUM_PROBES];
+    srand(1);
+    for (int i = 0; i < NUM_PROBES; ++i) {
+        probes[2 * i] = (float) rand() / RAND_MAX * (MAP_NUM_COLS + 2) * TILE_SIZE - TILE_SIZE;
+        probes[2 * i + 1] = (float) rand() / RAND_MAX * (MAP_NUM_ROWS + 2) * TILE_SIZE - TILE_SIZE;
+    }
+
+    struct BenchState state = {rc, NULL, 0, 0, 0};
+    printf("%-36s %12s %15s %15s\n", "benchmark", "iterations", "time", "throughput");
+    runBenchmark(&options, &state, "castRay/short/axis", benchCastRay, &shortAxisCast);
+    runBenchmark(&options, &state, "castRay/short/diagonal", benchCastRay, &shortDiagonalCast);
+    runBenchmark(&options, &state, "castRay/long/axis", benchCastRay, &longAxisCast);
+    runBenchmark(&options, &state, "castRay/long/diagonal", benchCastRay, &longDiagonalCast);
+    runBenchmark(&options, &state, "generate3DProjection/near", benchProjection, &nearWallDistance);
+    runBenchmark(&options, &state, "generate3DProjection/far", benchProjection, &farWallDistance);
+    rc->isGenericKernel = TRUE;
+    runBenchmark(&options, &state, "generate3DProjection/near/generic", benchProjection, &nearWallDistance);
+    runBenchmark(&options, &state, "generate3DProjection/far/generic", benchProjection, &farWallDistance);
+    rc->isGenericKernel = FALSE;
+    runBenchmark(&options, &state, "clearColorBuffer", benchClearColorBuffer, NULL);
+    runBenchmark(&options, &state, "mapHasWallAt", benchMapHasWallAt, probes);
+    // the PVS takes a while to build, so only for the benchmarks editing it
+    if (isSelected(&options, "pvs/edit") || isSelected(&options, "pvs/refresh")) {
+        world->hasPvs = buildPvs(&world->pvs, world->map.cells, world->map.numCols, world->map.numRows);
+    }
+    runBenchmark(&options, &state, "pvs/edit", benchPvsEdit, pvsEditCell);
+    runBenchmark(&options, &state, "pvs/refresh", benchPvsRefresh, pvsEditCell);
+    runDecodeBenchmarks(&options, &state);
+
+    // keeps the results alive
+    if (state.sink == 1234.5f) {
+        printf("\n");
+    }
+    destroyRaycaster(rc);
+    destroyWorld(world);
+    return 0;
+}
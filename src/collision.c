@@ -0,0 +1,78 @@
+#include <math.h>
+
+#include "collision.h"
+#include "map.h"
+
+static float clampFloat(float value, float min, float max) {
+    return value < min ? min : (value > max ? max : value);
+}
+
+// Moves along one axis and pushes the circle back out of every solid cell it ends up overlapping.
+// axis 0 moves along x, axis 1 along y; cross is the coordinate on the other axis.
+static float moveAxis(const struct Map *map, float position, float cross, float radius, float delta, int axis) {
+    float start = position;
+    position += delta;
+
+    int first = (int) floor((position - radius) / TILE_SIZE);
+    int last = (int) floor((position + radius) / TILE_SIZE);
+    int firstCross = (int) floor((cross - radius) / TILE_SIZE);
+    int lastCross = (int) floor((cross + radius) / TILE_SIZE);
+
+    for (int c = firstCross; c <= lastCross; ++c) {
+        for (int i = first; i <= last; ++i) {
+            if (!(axis == 0 ? mapIsSolidCell(map, i, c) : mapIsSolidCell(map, c, i))) {
+                continue;
+            }
+            float cellStart = i * TILE_SIZE;
+            float cellEnd = cellStart + TILE_SIZE;
+
+            // how far the circle reaches along the axis at the closest point of the cell
+            float closestCross = clampFloat(cross, c * TILE_SIZE, (c + 1) * TILE_SIZE);
+            float crossDistance = cross - closestCross;
+            if (fabs(crossDistance) >= radius) {
+                continue;
+            }
+            float reach = sqrt(radius * radius - crossDistance * crossDistance);
+
+            // only cells ahead of the start position can block, so an agent that already
+            // overlaps a wall is never pulled through it
+            if (delta > 0 && cellStart + TILE_SIZE / 2 > start && position + reach > cellStart) {
+                position = cellStart - reach;
+            } else if (delta < 0 && cellEnd - TILE_SIZE / 2 < start && position - reach < cellEnd) {
+                position = cellEnd + reach;
+            }
+        }
+    }
+
+    // a push never moves the circle behind where it started
+    if ((delta > 0 && position < start) || (delta < 0 && position > start)) {
+        position = start;
+    }
+    return position;
+}
+
+void collideMove(const struct Map *map, float *x, float *y, float radius, float dx, float dy) {
+    float distance = fabs(dx) > fabs(dy) ? fabs(dx) : fabs(dy);
+    int numSteps = (int) ceil(distance / (TILE_SIZE / 2));
+    if (numSteps < 1) {
+        numSteps = 1;
+    }
+    float stepX = dx / numSteps;
+    float stepY = dy / numSteps;
+
+    for (int i = 0; i < numSteps; ++i) {
+        if (stepX != 0) {
+            *x = moveAxis(map, *x, *y, radius, stepX, 0);
+        }
+        if (stepY != 0) {
+            *y = moveAxis(map, *y, *x, radius, stepY, 1);
+        }
+    }
+}
+
+void collideMoveBatch(const struct Map *map, float *xs, float *ys, const float *radii, const float *dxs,
+                      const float *dys, int count) {
+    for (int i = 0; i < count; ++i) {
+        collideMove(map, &xs[i], &ys[i], radii[i], dxs[i], dys[i]);
+    }
+}
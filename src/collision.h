@@ -0,0 +1,15 @@
+#ifndef RAYCASTING_COLLISION_H
+#define RAYCASTING_COLLISION_H
+
+#include "map.h"
+
+// Moves a circle by (dx, dy) against the solid cells of the map, one axis at a time,
+// so a blocked axis slides along the wall instead of stopping the whole move.
+// Long moves are split into steps no longer than half a cell, nothing tunnels through walls.
+void collideMove(const struct Map *map, float *x, float *y, float radius, float dx, float dy);
+
+// Same as collideMove() for count agents stored as parallel arrays.
+void collideMoveBatch(const struct Map *map, float *xs, float *ys, const float *radii, const float *dxs,
+                      const float *dys, int count);
+
+#endif //RAYCASTING_COLLISION_H
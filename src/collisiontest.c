@@ -0,0 +1,130 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "collision.h"
+#include "map.h"
+
+// Checks of collideMove() on a small fixed map: sliding along a wall, grazing an exact convex
+// corner, settling into a concave corner and moves longer than a cell. Prints every failing
+// check and makes the exit status 1, run by ctest.
+//
+// usage: collisiontest
+
+#define TEST_NUM_COLS 8
+#define TEST_NUM_ROWS 6
+#define RADIUS 10.0f
+#define EPSILON 0.01f
+
+// a room with a pillar at (3, 2) and a one cell thick wall at column 6
+static const int testMap[TEST_NUM_ROWS][TEST_NUM_COLS] = {
+        {1, 1, 1, 1, 1, 1, 1, 1},
+        {1, 0, 0, 0, 0, 0, 1, 1},
+        {1, 0, 0, 1, 0, 0, 1, 0},
+        {1, 0, 0, 0, 0, 0, 1, 0},
+        {1, 0, 0, 0, 0, 0, 1, 0},
+        {1, 1, 1, 1, 1, 1, 1, 1}
+};
+
+static int numFailures = 0;
+
+static void check(int condition, const char *name, float x, float y) {
+    if (!condition) {
+        ++numFailures;
+        printf("FAIL %s: ended at (%.3f, %.3f)\n", name, x, y);
+    }
+}
+
+static int isNear(float value, float expected) {
+    return fabs(value - expected) <= EPSILON;
+}
+
+// TRUE when the circle reaches into a solid cell by more than the tolerance
+static int overlapsWall(const struct Map *map, float x, float y, float radius) {
+    for (int row = (int) floor((y - radius) / TILE_SIZE); row <= (int) floor((y + radius) / TILE_SIZE); ++row) {
+        for (int col = (int) floor((x - radius) / TILE_SIZE); col <= (int) floor((x + radius) / TILE_SIZE); ++col) {
+            if (!mapIsSolidCell(map, col, row)) {
+                continue;
+            }
+            float closestX = x < col * TILE_SIZE ? col * TILE_SIZE : (x > (col + 1) * TILE_SIZE ? (col + 1) * TILE_SIZE : x);
+            float closestY = y < row * TILE_SIZE ? row * TILE_SIZE : (y > (row + 1) * TILE_SIZE ? (row + 1) * TILE_SIZE : y);
+            if (hypot(x - closestX, y - closestY) < radius - EPSILON) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+// moving up-right into the top wall keeps the x part of the move and stops y against the wall
+static void testSlideAlongWall(const struct Map *map) {
+    float x = 1.5f * TILE_SIZE;
+    float y = 1.5f * TILE_SIZE;
+    collideMove(map, &x, &y, RADIUS, 20, -40);
+    check(isNear(x, 1.5f * TILE_SIZE + 20), "slide keeps the move along the wall", x, y);
+    check(isNear(y, TILE_SIZE + RADIUS), "slide stops against the wall", x, y);
+    check(!overlapsWall(map, x, y, RADIUS), "slide stays out of the wall", x, y);
+}
+
+// a circle touching the pillar top edge at its corner passes by, and one aimed at the corner stops
+static void testConvexCorner(const struct Map *map) {
+    float x = 2.0f * TILE_SIZE;
+    float y = 2 * TILE_SIZE - RADIUS;
+    collideMove(map, &x, &y, RADIUS, TILE_SIZE + 20, 0);
+    check(isNear(x, 3.0f * TILE_SIZE + 20) && isNear(y, 2 * TILE_SIZE - RADIUS),
+          "tangent to a corner moves freely", x, y);
+
+    // straight at the top-left corner of the pillar along the diagonal
+    float offset = 3 * RADIUS;
+    x = 3 * TILE_SIZE - offset;
+    y = 2 * TILE_SIZE - offset;
+    collideMove(map, &x, &y, RADIUS, offset, offset);
+    check(!overlapsWall(map, x, y, RADIUS), "diagonal into a corner stays out of the pillar", x, y);
+    check(x > 3 * TILE_SIZE - offset && y > 2 * TILE_SIZE - offset, "diagonal into a corner still moves", x, y);
+}
+
+// pushing into the top-left corner of the room settles touching both walls
+static void testConcaveCorner(const struct Map *map) {
+    float x = 1.5f * TILE_SIZE;
+    float y = 1.5f * TILE_SIZE;
+    collideMove(map, &x, &y, RADIUS, -40, -40);
+    check(isNear(x, TILE_SIZE + RADIUS) && isNear(y, TILE_SIZE + RADIUS), "concave corner settles on both walls", x,
+          y);
+
+    // again from the corner itself, nothing moves
+    collideMove(map, &x, &y, RADIUS, -5, -5);
+    check(isNear(x, TILE_SIZE + RADIUS) && isNear(y, TILE_SIZE + RADIUS), "concave corner holds", x, y);
+}
+
+// moves of several cells in one call stop at the first wall instead of jumping over it
+static void testNoTunneling(const struct Map *map) {
+    float x = 5.5f * TILE_SIZE;
+    float y = 3.5f * TILE_SIZE;
+    collideMove(map, &x, &y, RADIUS, 3 * TILE_SIZE, 0);
+    check(isNear(x, 6 * TILE_SIZE - RADIUS) && isNear(y, 3.5f * TILE_SIZE), "fast move stops at a thin wall", x, y);
+
+    x = 5.5f * TILE_SIZE;
+    y = 4.5f * TILE_SIZE;
+    collideMove(map, &x, &y, RADIUS, 2.5f * TILE_SIZE, 2.5f * TILE_SIZE);
+    check(x < 6 * TILE_SIZE && y < 5 * TILE_SIZE && !overlapsWall(map, x, y, RADIUS),
+          "fast diagonal stays in the room", x, y);
+}
+
+int main(void) {
+    struct Map map;
+    if (!initMap(&map, &testMap[0][0], TEST_NUM_COLS, TEST_NUM_ROWS)) {
+        fprintf(stderr, "Error creating the map\n");
+        return 1;
+    }
+    testSlideAlongWall(&map);
+    testConvexCorner(&map);
+    testConcaveCorner(&map);
+    testNoTunneling(&map);
+    freeMap(&map);
+
+    if (numFailures > 0) {
+        printf("%d collision checks failed\n", numFailures);
+        return 1;
+    }
+    printf("collision checks passed\n");
+    return 0;
+}
@@ -12,11 +12,20 @@
 #define TWO_PI 6.28318530
 
 #define MINI_MAP_SCALE_FACTOR 0.2
+#define MAX_MINI_MAP_SIZE 320 // pixels, larger maps get a smaller scale
+#define MAX_MINI_MAP_RAYS 160 // the minimap ray fan keeps every n-th ray only
 #define TILE_SIZE 64
 #define MAP_NUM_ROWS 13
 #define MAP_NUM_COLS 20
 
 #define NUM_TEXTURES 8
+#define NUM_SPRITE_TEXTURES 2
+
+#define MAX_SPRITES 8192
+
+#define DOOR_CELL 9
+#define DOOR_TEXTURE 6
+#define MAX_DOORS 64
 
 #define WINDOW_WIDTH (MAP_NUM_COLS * TILE_SIZE)
 #define WINDOW_HEIGHT (MAP_NUM_ROWS * TILE_SIZE)
@@ -24,12 +33,41 @@
 #define TEXTURE_WIDTH 64
 #define TEXTURE_HEIGHT 64
 
+#define CEILING_COLOR 0xFF333333
+#define FLOOR_COLOR 0xFF777777
+#define FOG_COLOR 0xFF000000 // what far walls fade to in RENDER_MODE_FULL
+
 #define FOV_ANGLE (60 * (PI / 180)) // in radians
 
 #define NUM_RAYS WINDOW_WIDTH
 
+#define PVS_FILE "map.pvs"
+#define PVS_REFRESH_BUDGET_NS 250000 // time spent rebuilding stale PVS sets per update
+// How far from its center a sprite can show. Sprites are billboards a tile wide, the rest is
+// room for their projection at the screen edges; the PVS and sprite culling rely on it.
+#define SPRITE_REACH TILE_SIZE
+
+// transient memory, see arena.h
+#define FRAME_ARENA_SIZE (64 * 1024)   // per view, on top of the room for the sprite sort
+#define THREAD_ARENA_SIZE (256 * 1024) // room for the sort of a full sprite list and the tile tables of renderViews()
+#define MAX_ARENA_THREADS 64
+
+// what a view renders, see renderColumns()
+#define RENDER_MODE_FULL 0  // textured ARGB walls and sprites
+#define RENDER_MODE_DEPTH 1 // rays only: per column distance and wall content
+#define RENDER_MODE_GRAY 2  // flat shaded 8-bit walls, no texture sampling and no sprites
+#define RENDER_MODE_INDEXED 3 // 8-bit palette indices, shaded through the colormap, expanded before present
+#define NUM_RENDER_MODES 4
+
+// distance and side lighting of the textured modes
+#define NUM_LIGHT_LEVELS 32
+#define LIGHT_FALLOFF_DISTANCE 40 // distance that costs one light level
+#define MIN_LIGHT_LEVEL 8
+#define SIDE_LIGHT_DROP 4 // vertical faces are this many levels darker
+
 #define FPS 30
 #define FRAME_TIME_LENGTH (1000 / FPS)
+#define IDLE_WAIT_TIME 500 // longest sleep of an idle loop waiting for events, in ms
 
 
 
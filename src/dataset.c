@@ -0,0 +1,383 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "raycaster.h"
+#include "multiview.h"
+#include "minimap.h"
+#include "alignedalloc.h"
+#ifdef RAYCASTING_ALLOC_COUNT
+#include "alloccount.h"
+#endif
+
+// Headless renderer for dataset generation: reads camera poses, one "x y angle" per line
+// ('#' starts a comment), renders every pose without SDL and streams the frames out as raw
+// uint8 tensors of shape [height][width][channels], RGBA or grayscale. With -d, every frame is
+// followed by width float32 values, the distance to the wall hit by each (downscaled) column.
+// The render mode (-m) trades detail for speed: "gray" frames are flat shaded walls without
+// textures or sprites, "depth" frames are only the distances, "indexed" frames are rendered with
+// 8-bit palette textures and written out as RGBA like full ones.
+//
+// usage: dataset [-i poses] [-o frames] [-w width] [-h height] [-s scale] [-g] [-d] [-t threads]
+//                [-m full|depth|gray|indexed] [-n] [-r] [-v] [-k] [-a] [-H]
+// With -n the frames get the software minimap in their top left corner. With -r every view reuses
+// the rays of its previous pose when only the angle changed, poses then go to the views round
+// robin, so a file interleaving one pose per view and per step benefits the most. With -v the rays
+// of every incremental frame are checked against a full recast, and any mismatch fails the run.
+// With -k the walls are drawn with the generic kernel, to compare its speed with the specialized ones.
+// With -a the heap allocations after the first batch are counted, and any makes the run fail: the
+// steady state of the render loop must not allocate (builds with allocation counting only).
+// With -H the frame buffers and textures are backed by transparent huge pages where possible.
+
+// poses rendered per thread in one batch, enough to keep every thread busy to the end of a phase
+#define VIEWS_PER_THREAD 2
+
+struct DatasetOptions {
+    const char *posesPath;
+    const char *outputPath;
+    int width;
+    int height;
+    int scale;       // integer downscale factor, box filtered
+    int renderMode;
+    int isGrayscale;
+    int hasDepth;
+    int hasMiniMap;
+    int isIncremental;
+    int isVerified;
+    int isGenericKernel;
+    int isAllocationChecked;
+    int hasHugePages;
+    int numThreads;
+};
+
+static double currentSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static int parseOptions(int argc, char *argv[], struct DatasetOptions *options) {
+    options->posesPath = NULL;
+    options->outputPath = NULL;
+    options->width = WINDOW_WIDTH;
+    options->height = WINDOW_HEIGHT;
+    options->scale = 1;
+    options->renderMode = RENDER_MODE_FULL;
+    options->isGrayscale = FALSE;
+    options->hasDepth = FALSE;
+    options->hasMiniMap = FALSE;
+    options->isIncremental = FALSE;
+    options->isVerified = FALSE;
+    options->isGenericKernel = FALSE;
+    options->isAllocationChecked = FALSE;
+    options->hasHugePages = FALSE;
+    options->numThreads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-g") == 0) {
+            options->isGrayscale = TRUE;
+        } else if (strcmp(arg, "-d") == 0) {
+            options->hasDepth = TRUE;
+        } else if (strcmp(arg, "-n") == 0) {
+            options->hasMiniMap = TRUE;
+        } else if (strcmp(arg, "-r") == 0) {
+            options->isIncremental = TRUE;
+        } else if (strcmp(arg, "-v") == 0) {
+            options->isIncremental = TRUE;
+            options->isVerified = TRUE;
+        } else if (strcmp(arg, "-k") == 0) {
+            options->isGenericKernel = TRUE;
+        } else if (strcmp(arg, "-H") == 0) {
+            options->hasHugePages = TRUE;
+        } else if (strcmp(arg, "-a") == 0) {
+#ifdef RAYCASTING_ALLOC_COUNT
+            options->isAllocationChecked = TRUE;
+#else
+            fprintf(stderr, "-a needs a build with allocation counting\n");
+            return FALSE;
+#endif
+        } else if (!value) {
+            return FALSE;
+        } else if (strcmp(arg, "-i") == 0) {
+            options->posesPath = value;
+            ++i;
+        } else if (strcmp(arg, "-o") == 0) {
+            options->outputPath = value;
+            ++i;
+        } else if (strcmp(arg, "-w") == 0) {
+            options->width = atoi(value);
+            ++i;
+        } else if (strcmp(arg, "-h") == 0) {
+            options->height = atoi(value);
+            ++i;
+        } else if (strcmp(arg, "-s") == 0) {
+            options->scale = atoi(value);
+            ++i;
+        } else if (strcmp(arg, "-t") == 0) {
+            options->numThreads = atoi(value);
+            ++i;
+        } else if (strcmp(arg, "-m") == 0) {
+            if (strcmp(value, "full") == 0) {
+                options->renderMode = RENDER_MODE_FULL;
+            } else if (strcmp(value, "depth") == 0) {
+                options->renderMode = RENDER_MODE_DEPTH;
+            } else if (strcmp(value, "gray") == 0) {
+                options->renderMode = RENDER_MODE_GRAY;
+            } else if (strcmp(value, "indexed") == 0) {
+                options->renderMode = RENDER_MODE_INDEXED;
+            } else {
+                return FALSE;
+            }
+            ++i;
+        } else {
+            return FALSE;
+        }
+    }
+    if (options->renderMode == RENDER_MODE_DEPTH) {
+        options->hasDepth = TRUE;
+    } else if (options->renderMode == RENDER_MODE_GRAY) {
+        options->isGrayscale = TRUE;
+    }
+    return options->width > 0 && options->height > 0 && options->scale > 0 &&
+           options->width >= options->scale && options->height >= options->scale && options->numThreads >= 0;
+}
+
+static int readPose(FILE *file, struct Camera *camera) {
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%f %f %f", &camera->x, &camera->y, &camera->angle) == 3) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Casts the rays of the view again from scratch, at the same angles, and returns the number of
+// columns whose ray differs from the incremental one.
+static int verifyRays(const struct Raycaster *view, struct Raycaster *reference) {
+    reference->camera = view->camera;
+    reference->hasCachedRays = FALSE;
+    castAllRays(reference);
+    int numMismatches = 0;
+    for (int i = 0; i < view->width; ++i) {
+        if (memcmp(&view->rays[i], &reference->rays[i], sizeof(struct Ray)) != 0) {
+            ++numMismatches;
+        }
+    }
+    return numMismatches;
+}
+
+// Box filters the frame of the context into out and returns its size in bytes.
+static size_t packFrame(const struct Raycaster *rc, const struct DatasetOptions *options, uint8_t *out) {
+    int scale = options->scale;
+    int outWidth = rc->width / scale;
+    int outHeight = rc->height / scale;
+    int numSamples = scale * scale;
+    uint8_t *pixel = out;
+
+    if (rc->renderMode == RENDER_MODE_GRAY) {
+        for (int y = 0; y < outHeight; ++y) {
+            for (int x = 0; x < outWidth; ++x) {
+                unsigned sum = 0;
+                for (int sy = 0; sy < scale; ++sy) {
+                    const uint8_t *row = rc->grayBuffer + rc->width * (y * scale + sy) + x * scale;
+                    for (int sx = 0; sx < scale; ++sx) {
+                        sum += row[sx];
+                    }
+                }
+                *pixel++ = sum / numSamples;
+            }
+        }
+    } else if (rc->renderMode == RENDER_MODE_FULL || rc->renderMode == RENDER_MODE_INDEXED) {
+        for (int y = 0; y < outHeight; ++y) {
+            for (int x = 0; x < outWidth; ++x) {
+                unsigned red = 0, green = 0, blue = 0;
+                for (int sy = 0; sy < scale; ++sy) {
+                    const uint32_t *row = rc->colorBuffer + rc->width * (y * scale + sy) + x * scale;
+                    for (int sx = 0; sx < scale; ++sx) {
+                        red += (row[sx] >> 16) & 0xFF;
+                        green += (row[sx] >> 8) & 0xFF;
+                        blue += row[sx] & 0xFF;
+                    }
+                }
+                red /= numSamples;
+                green /= numSamples;
+                blue /= numSamples;
+                if (options->isGrayscale) {
+                    // BT.601 luma in 8 bit fixed point
+                    *pixel++ = (77 * red + 150 * green + 29 * blue) >> 8;
+                } else {
+                    *pixel++ = red;
+                    *pixel++ = green;
+                    *pixel++ = blue;
+                    *pixel++ = 0xFF;
+                }
+            }
+        }
+    }
+
+    if (options->hasDepth) {
+        for (int x = 0; x < outWidth; ++x) {
+            float depth = 0;
+            for (int sx = 0; sx < scale; ++sx) {
+                depth += rc->rays[x * scale + sx].distance;
+            }
+            depth /= scale;
+            memcpy(pixel, &depth, sizeof(depth));
+            pixel += sizeof(depth);
+        }
+    }
+    return pixel - out;
+}
+
+int main(int argc, char *argv[]) {
+    struct DatasetOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        fprintf(stderr, "usage: dataset [-i poses] [-o frames] [-w width] [-h height] [-s scale] [-g] [-d] "
+                        "[-t threads] [-m full|depth|gray|indexed] [-n] [-r] [-v] [-k] [-a] [-H]\n");
+        return 1;
+    }
+    FILE *posesFile = options.posesPath ? fopen(options.posesPath, "r") : stdin;
+    FILE *outputFile = options.outputPath ? fopen(options.outputPath, "wb") : stdout;
+    if (!posesFile || !outputFile) {
+        fprintf(stderr, "Error opening %s\n", !posesFile ? options.posesPath : options.outputPath);
+        return 1;
+    }
+
+    setHugePages(options.hasHugePages);
+    struct World *world = createWorld(&defaultMap[0][0], MAP_NUM_COLS, MAP_NUM_ROWS);
+    struct ThreadPool *pool = createThreadPool(options.numThreads);
+    if (!world || !pool) {
+        fprintf(stderr, "Error creating the world\n");
+        return 1;
+    }
+    worldLoadPvs(world, PVS_FILE);
+
+    // every buffer is allocated once and reused for all the batches
+    int numViews = threadPoolSize(pool) * VIEWS_PER_THREAD;
+    struct Raycaster **views = malloc(sizeof(struct Raycaster *) * numViews);
+    int outWidth = options.width / options.scale;
+    int outHeight = options.height / options.scale;
+    int numChannels = options.renderMode == RENDER_MODE_DEPTH ? 0 : (options.isGrayscale ? 1 : 4);
+    size_t frameSize = (size_t) outWidth * outHeight * numChannels + (options.hasDepth ? sizeof(float) * outWidth : 0);
+    uint8_t *frame = malloc(frameSize);
+    if (!views || !frame) {
+        fprintf(stderr, "Error allocating the frame buffers\n");
+        return 1;
+    }
+    for (int i = 0; i < numViews; ++i) {
+        views[i] = createRaycaster(world, options.width, options.height);
+        if (!views[i]) {
+            fprintf(stderr, "Error creating the raycaster\n");
+            return 1;
+        }
+        views[i]->renderMode = options.renderMode;
+        views[i]->isIncremental = options.isIncremental;
+        views[i]->isGenericKernel = options.isGenericKernel;
+    }
+    struct Raycaster *reference = NULL;
+    if (options.isVerified) {
+        reference = createRaycaster(world, options.width, options.height);
+        if (!reference) {
+            fprintf(stderr, "Error creating the raycaster\n");
+            return 1;
+        }
+        reference->isIncremental = TRUE;
+    }
+
+    long numFrames = 0;
+    long numCastColumns = 0;
+    long numMismatchedFrames = 0;
+    long numAllocations = 0; // after the first batch, which warms up the caches and arenas
+    double renderSeconds = 0;
+    double startTime = currentSeconds();
+    for (;;) {
+        int numPoses = 0;
+        while (numPoses < numViews && readPose(posesFile, &views[numPoses]->camera)) {
+            ++numPoses;
+        }
+        if (numPoses == 0) {
+            break;
+        }
+        double renderStart = currentSeconds();
+        renderViews(pool, views, numPoses);
+        renderSeconds += currentSeconds() - renderStart;
+
+        for (int i = 0; i < numPoses; ++i) {
+            numCastColumns += options.isIncremental ? views[i]->castLast - views[i]->castFirst : views[i]->width;
+            if (reference) {
+                int numMismatches = verifyRays(views[i], reference);
+                if (numMismatches > 0) {
+                    fprintf(stderr, "frame %ld: %d columns differ from a full recast\n", numFrames + i,
+                            numMismatches);
+                    ++numMismatchedFrames;
+                }
+            }
+            if (views[i]->renderMode == RENDER_MODE_INDEXED) {
+                expandIndexBuffer(views[i]);
+            }
+            if (options.hasMiniMap && views[i]->renderMode != RENDER_MODE_GRAY &&
+                views[i]->renderMode != RENDER_MODE_DEPTH) {
+                drawMiniMap(views[i]);
+            }
+            size_t size = packFrame(views[i], &options, frame);
+            if (fwrite(frame, 1, size, outputFile) != size) {
+                fprintf(stderr, "Error writing the frames\n");
+                return 1;
+            }
+        }
+#ifdef RAYCASTING_ALLOC_COUNT
+        numAllocations = numFrames == 0 ? -heapAllocationCount() : numAllocations;
+#endif
+        numFrames += numPoses;
+    }
+    double totalSeconds = currentSeconds() - startTime;
+#ifdef RAYCASTING_ALLOC_COUNT
+    numAllocations += heapAllocationCount();
+#endif
+
+    fprintf(stderr, "%ld frames of %dx%dx%d%s, %d threads\n", numFrames, outHeight, outWidth, numChannels,
+            options.hasDepth ? " + depth" : "", threadPoolSize(pool));
+    if (numFrames > 0) {
+        fprintf(stderr, "rendering: %.1f frames/s, %.1f frames/s/core; with output: %.1f frames/s\n",
+                numFrames / renderSeconds, numFrames / renderSeconds / threadPoolSize(pool),
+                numFrames / totalSeconds);
+    }
+    if (options.isIncremental && numFrames > 0) {
+        fprintf(stderr, "incremental casting: %.1f%% of the columns cast", 100.0 * numCastColumns /
+                                                                           ((double) numFrames * options.width));
+        if (reference) {
+            fprintf(stderr, ", %ld frames differ from a full recast", numMismatchedFrames);
+        }
+        fprintf(stderr, "\n");
+    }
+    int status = numMismatchedFrames > 0;
+    if (options.isAllocationChecked) {
+        fprintf(stderr, "heap allocations after the first batch: %ld\n", numAllocations);
+        status |= numAllocations > 0;
+    }
+
+    for (int i = 0; i < numViews; ++i) {
+        destroyRaycaster(views[i]);
+    }
+    destroyRaycaster(reference);
+    free(views);
+    free(frame);
+    destroyThreadPool(pool);
+    destroyWorld(world);
+    if (posesFile != stdin) {
+        fclose(posesFile);
+    }
+    if (outputFile != stdout) {
+        fclose(outputFile);
+    }
+    return status;
+}
@@ -0,0 +1,260 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raycaster.h"
+
+// Golden image checks of the renderer: renders fixed camera poses of the stock map headlessly,
+// in every render mode with pixels, and either stores the frames and ray tables as the golden
+// ones (capture) or compares them to the stored ones (compare, exit status 1 on a mismatch).
+// Frames are PPM/PGM images, ray tables one "column distance vertical content" line per column.
+// Capture with a build known to be right, before touching the caster or the projection.
+//
+// usage: golden capture|compare [-d directory] [-t] [-k]
+// With -t the comparison tolerates small differences, for fast-math or SIMD paths: pixels off by
+// a few levels, a few columns hitting another wall, distances within a relative error. With -k
+// the walls are drawn by the generic kernels, which step down the textures slightly differently.
+// The references of golden/ are checked by ctest exactly, and with -k -t: compared exactly, -k
+// makes 18 of the 30 images differ (the full and indexed frames of 9 poses, 400 to 1200 pixels
+// each) on an unchanged tree, all within the tolerance. Capture them again after an intended
+// change to the output, and commit them with it.
+
+#define GOLDEN_WIDTH 640
+#define GOLDEN_HEIGHT 416
+
+// tolerance mode
+#define PIXEL_TOLERANCE 8        // per channel
+#define MAX_PIXEL_MISMATCHES 0.01f // of the pixels, beyond the per channel tolerance
+#define DISTANCE_TOLERANCE 1e-3f // relative
+#define MAX_RAY_MISMATCHES 0.01f // of the columns
+
+struct GoldenPose {
+    float x;
+    float y;
+    float angle;
+};
+
+// the axis angles, a door, corners and grazing views
+static const struct GoldenPose poses[] = {
+        {640, 416, 0},
+        {640, 416, PI / 2},
+        {640, 416, PI},
+        {640, 416, 3 * PI / 2},
+        {200, 200, 0.7f},
+        {930, 224, 0},
+        {1100, 600, 2.5f},
+        {96, 96, PI / 4},
+        {1200, 700, 4.0f},
+        {480, 330, 5.9f}
+};
+
+static const int renderModes[] = {RENDER_MODE_FULL, RENDER_MODE_GRAY, RENDER_MODE_INDEXED};
+static const char *renderModeNames[] = {"full", "depth", "gray", "indexed"};
+
+static void populateGoldenWorld(struct World *world) {
+    worldAddSprite(world, 2.5f * TILE_SIZE, 2.5f * TILE_SIZE, 0, FALSE);
+    worldAddSprite(world, 10.5f * TILE_SIZE, 10.5f * TILE_SIZE, 0, FALSE);
+    worldAddSprite(world, 17.5f * TILE_SIZE, 10.5f * TILE_SIZE, 1, FALSE);
+    worldAddSprite(world, 8.5f * TILE_SIZE, 5.5f * TILE_SIZE, 1, FALSE);
+}
+
+// frame of the context as tightly packed RGB, or gray levels in RENDER_MODE_GRAY
+static int packPixels(struct Raycaster *rc, uint8_t *pixels) {
+    int numPixels = rc->width * rc->height;
+    if (rc->renderMode == RENDER_MODE_GRAY) {
+        memcpy(pixels, rc->grayBuffer, numPixels);
+        return 1;
+    }
+    if (rc->renderMode == RENDER_MODE_INDEXED) {
+        expandIndexBuffer(rc);
+    }
+    for (int i = 0; i < numPixels; ++i) {
+        pixels[3 * i] = (rc->colorBuffer[i] >> 16) & 0xFF;
+        pixels[3 * i + 1] = (rc->colorBuffer[i] >> 8) & 0xFF;
+        pixels[3 * i + 2] = rc->colorBuffer[i] & 0xFF;
+    }
+    return 3;
+}
+
+static int writeImage(const char *path, const uint8_t *pixels, int width, int height, int numChannels) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return FALSE;
+    }
+    fprintf(file, "P%d\n%d %d\n255\n", numChannels == 1 ? 5 : 6, width, height);
+    size_t size = (size_t) width * height * numChannels;
+    int isWritten = fwrite(pixels, 1, size, file) == size;
+    return fclose(file) == 0 && isWritten;
+}
+
+static int readImage(const char *path, uint8_t *pixels, int width, int height, int numChannels) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return FALSE;
+    }
+    int format, fileWidth, fileHeight, maxValue;
+    int isRead = fscanf(file, "P%d %d %d %d", &format, &fileWidth, &fileHeight, &maxValue) == 4 &&
+                 format == (numChannels == 1 ? 5 : 6) && fileWidth == width && fileHeight == height &&
+                 maxValue == 255 && fgetc(file) == '\n';
+    size_t size = (size_t) width * height * numChannels;
+    isRead = isRead && fread(pixels, 1, size, file) == size;
+    fclose(file);
+    return isRead;
+}
+
+static int writeRays(const char *path, const struct Raycaster *rc) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return FALSE;
+    }
+    for (int i = 0; i < rc->width; ++i) {
+        // 9 digits, floats read back exactly
+        fprintf(file, "%d %.9g %d %d\n", i, rc->rays[i].distance, rc->rays[i].wasHitVertical,
+                rc->rays[i].wallHitContent);
+    }
+    return fclose(file) == 0;
+}
+
+// Compares the rays of the context with a stored table, returns the number of differing columns
+// or -1 when the table cannot be read.
+static int compareRays(const char *path, const struct Raycaster *rc, int isTolerant) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    int numMismatches = 0;
+    for (int i = 0; i < rc->width; ++i) {
+        int column, isVertical, content;
+        float distance;
+        if (fscanf(file, "%d %f %d %d", &column, &distance, &isVertical, &content) != 4 || column != i) {
+            fclose(file);
+            return -1;
+        }
+        const struct Ray *ray = &rc->rays[i];
+        int isSame = isTolerant
+                     ? fabsf(ray->distance - distance) <= DISTANCE_TOLERANCE * distance
+                     : ray->distance == distance;
+        if (!isSame || ray->wasHitVertical != isVertical || ray->wallHitContent != content) {
+            ++numMismatches;
+        }
+    }
+    fclose(file);
+    return numMismatches;
+}
+
+// returns the number of pixels with a channel off by more than the tolerance, 0 when exact
+static int comparePixels(const uint8_t *pixels, const uint8_t *golden, int numPixels, int numChannels, int tolerance) {
+    int numMismatches = 0;
+    for (int i = 0; i < numPixels; ++i) {
+        for (int c = 0; c < numChannels; ++c) {
+            if (abs(pixels[numChannels * i + c] - golden[numChannels * i + c]) > tolerance) {
+                ++numMismatches;
+                break;
+            }
+        }
+    }
+    return numMismatches;
+}
+
+int main(int argc, char *argv[]) {
+    const char *directory = ".";
+    int isCapture = argc > 1 && strcmp(argv[1], "capture") == 0;
+    int isCompare = argc > 1 && strcmp(argv[1], "compare") == 0;
+    int isTolerant = FALSE;
+    int isGenericKernel = FALSE;
+    int isValid = isCapture || isCompare;
+    for (int i = 2; i < argc && isValid; ++i) {
+        if (strcmp(argv[i], "-t") == 0) {
+            isTolerant = TRUE;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            isGenericKernel = TRUE;
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            directory = argv[++i];
+        } else {
+            isValid = FALSE;
+        }
+    }
+    if (!isValid) {
+        fprintf(stderr, "usage: golden capture|compare [-d directory] [-t] [-k]\n");
+        return 2;
+    }
+
+    struct World *world = createWorld(&defaultMap[0][0], MAP_NUM_COLS, MAP_NUM_ROWS);
+    struct Raycaster *rc = world ? createRaycaster(world, GOLDEN_WIDTH, GOLDEN_HEIGHT) : NULL;
+    uint8_t *pixels = malloc((size_t) GOLDEN_WIDTH * GOLDEN_HEIGHT * 3);
+    uint8_t *golden = malloc((size_t) GOLDEN_WIDTH * GOLDEN_HEIGHT * 3);
+    if (!rc || !pixels || !golden) {
+        fprintf(stderr, "Error creating the renderer\n");
+        return 2;
+    }
+    // without the PVS the sprites are culled by the grid alone, the frames do not depend on a built PVS file
+    populateGoldenWorld(world);
+    rc->isGenericKernel = isGenericKernel;
+
+    int numPoses = sizeof(poses) / sizeof(poses[0]);
+    int numModes = sizeof(renderModes) / sizeof(renderModes[0]);
+    int numFailures = 0;
+    char path[1024];
+    for (int p = 0; p < numPoses; ++p) {
+        rc->camera.x = poses[p].x;
+        rc->camera.y = poses[p].y;
+        rc->camera.angle = poses[p].angle;
+        for (int m = 0; m < numModes; ++m) {
+            rc->renderMode = renderModes[m];
+            renderFrame(rc);
+            int numChannels = packPixels(rc, pixels);
+            snprintf(path, sizeof(path), "%s/pose%02d_%s.%s", directory, p, renderModeNames[rc->renderMode],
+                     numChannels == 1 ? "pgm" : "ppm");
+            if (isCapture) {
+                if (!writeImage(path, pixels, rc->width, rc->height, numChannels)) {
+                    fprintf(stderr, "Error writing %s\n", path);
+                    return 2;
+                }
+                continue;
+            }
+            if (!readImage(path, golden, rc->width, rc->height, numChannels)) {
+                fprintf(stderr, "%s: missing or unreadable\n", path);
+                ++numFailures;
+                continue;
+            }
+            int numMismatches = comparePixels(pixels, golden, rc->width * rc->height, numChannels,
+                                              isTolerant ? PIXEL_TOLERANCE : 0);
+            int maxMismatches = isTolerant ? (int) (MAX_PIXEL_MISMATCHES * rc->width * rc->height) : 0;
+            if (numMismatches > maxMismatches) {
+                fprintf(stderr, "%s: %d pixels differ\n", path, numMismatches);
+                ++numFailures;
+            }
+        }
+
+        // the rays are the same in every mode
+        snprintf(path, sizeof(path), "%s/pose%02d_rays.txt", directory, p);
+        if (isCapture) {
+            if (!writeRays(path, rc)) {
+                fprintf(stderr, "Error writing %s\n", path);
+                return 2;
+            }
+            continue;
+        }
+        int numMismatches = compareRays(path, rc, isTolerant);
+        int maxMismatches = isTolerant ? (int) (MAX_RAY_MISMATCHES * rc->width) : 0;
+        if (numMismatches < 0) {
+            fprintf(stderr, "%s: missing or unreadable\n", path);
+            ++numFailures;
+        } else if (numMismatches > maxMismatches) {
+            fprintf(stderr, "%s: %d columns differ\n", path, numMismatches);
+            ++numFailures;
+        }
+    }
+
+    if (isCapture) {
+        printf("Captured %d poses in %s\n", numPoses, directory);
+    } else {
+        printf("%d poses, %d mismatches%s\n", numPoses, numFailures, isTolerant ? " (tolerant)" : "");
+    }
+    free(pixels);
+    free(golden);
+    destroyRaycaster(rc);
+    destroyWorld(world);
+    return numFailures > 0;
+}
@@ -0,0 +1,120 @@
+#include <ctype.h>
+#include <stdio.h>
+
+#include "constants.h"
+#include "hud.h"
+#include "profiler.h"
+
+#define HUD_TEXT_SCALE 2
+#define HUD_LINE_HEIGHT (7 * HUD_TEXT_SCALE)
+#define HUD_MARGIN 8
+#define HUD_GRAPH_HEIGHT 60
+#define HUD_GRAPH_BAR_WIDTH 2
+
+// 3x5 glyphs, 3 bits per row from the top row down, the most significant bit on the left
+static const uint16_t digitGlyphs[10] = {
+        0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF
+};
+
+static const uint16_t letterGlyphs[26] = {
+        0x2BED, 0x6BAE, 0x3923, 0x6B6E, 0x79A7, 0x79A4, 0x396B, 0x5BED, 0x7497, 0x126A, 0x5BAD, 0x4927, 0x5FED,
+        0x6B6D, 0x2B6A, 0x6BA4, 0x2B73, 0x6BAD, 0x388E, 0x7492, 0x5B6F, 0x5B6A, 0x5BFD, 0x5AAD, 0x5A92, 0x72A7
+};
+
+static uint16_t glyphOf(char c) {
+    if (c >= '0' && c <= '9') {
+        return digitGlyphs[c - '0'];
+    }
+    if (isalpha((unsigned char) c)) {
+        return letterGlyphs[toupper((unsigned char) c) - 'A'];
+    }
+    switch (c) {
+        case '.':
+            return 0x0002;
+        case ':':
+            return 0x0410;
+        case '-':
+            return 0x01C0;
+        case '/':
+            return 0x12A4;
+        default:
+            return 0;
+    }
+}
+
+static void fillRect(uint32_t *colorBuffer, int width, int height, int x, int y, int w, int h, uint32_t color) {
+    for (int row = y < 0 ? 0 : y; row < y + h && row < height; ++row) {
+        for (int col = x < 0 ? 0 : x; col < x + w && col < width; ++col) {
+            colorBuffer[width * row + col] = color;
+        }
+    }
+}
+
+static void darkenRect(uint32_t *colorBuffer, int width, int height, int x, int y, int w, int h) {
+    for (int row = y < 0 ? 0 : y; row < y + h && row < height; ++row) {
+        for (int col = x < 0 ? 0 : x; col < x + w && col < width; ++col) {
+            uint32_t *pixel = &colorBuffer[width * row + col];
+            *pixel = 0xFF000000 | ((*pixel >> 2) & 0x003F3F3F);
+        }
+    }
+}
+
+void drawHudText(uint32_t *colorBuffer, int width, int height, int x, int y, const char *text, uint32_t color,
+                 int scale) {
+    for (; *text; ++text, x += 4 * scale) {
+        uint16_t glyph = glyphOf(*text);
+        for (int row = 0; row < 5; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                if (glyph & (1 << (14 - row * 3 - col))) {
+                    fillRect(colorBuffer, width, height, x + col * scale, y + row * scale, scale, scale, color);
+                }
+            }
+        }
+    }
+}
+
+void drawProfilerHud(uint32_t *colorBuffer, int width, int height) {
+    int panelWidth = PROFILE_HISTORY * HUD_GRAPH_BAR_WIDTH + 2 * HUD_MARGIN;
+    int panelHeight = (NUM_PROFILE_STAGES + NUM_PROFILE_ARENAS) * HUD_LINE_HEIGHT + HUD_GRAPH_HEIGHT + 3 * HUD_MARGIN;
+    int panelX = width - panelWidth - HUD_MARGIN;
+    int panelY = HUD_MARGIN;
+    darkenRect(colorBuffer, width, height, panelX, panelY, panelWidth, panelHeight);
+
+    // rolling averages, the tile stages add up the time of all the threads
+    char line[64];
+    for (int stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+        snprintf(line, sizeof(line), "%s", profileStageName(stage));
+        int y = panelY + HUD_MARGIN + stage * HUD_LINE_HEIGHT;
+        drawHudText(colorBuffer, width, height, panelX + HUD_MARGIN, y, line, 0xFFFFFFFF, HUD_TEXT_SCALE);
+        snprintf(line, sizeof(line), "%6.2f ms", profileAverageMs(stage));
+        drawHudText(colorBuffer, width, height, panelX + panelWidth - HUD_MARGIN - 9 * 4 * HUD_TEXT_SCALE, y, line,
+                    0xFFFFFF00, HUD_TEXT_SCALE);
+    }
+    // high-water marks of the transient memory
+    for (int kind = 0; kind < NUM_PROFILE_ARENAS; ++kind) {
+        size_t size;
+        size_t highWater = profileArenaHighWater(kind, &size);
+        int y = panelY + HUD_MARGIN + (NUM_PROFILE_STAGES + kind) * HUD_LINE_HEIGHT;
+        drawHudText(colorBuffer, width, height, panelX + HUD_MARGIN, y, profileArenaName(kind), 0xFFFFFFFF,
+                    HUD_TEXT_SCALE);
+        snprintf(line, sizeof(line), "%4zu/%zu KB", highWater / 1024, size / 1024);
+        drawHudText(colorBuffer, width, height, panelX + panelWidth - HUD_MARGIN - 12 * 4 * HUD_TEXT_SCALE, y, line,
+                    0xFFFFFF00, HUD_TEXT_SCALE);
+    }
+
+    // frame time graph, full height is twice the frame budget
+    float frameBudgetMs = 1000.0f / FPS;
+    float frameTimes[PROFILE_HISTORY];
+    int numFrames = profileFrameTimes(frameTimes, PROFILE_HISTORY);
+    int graphX = panelX + HUD_MARGIN;
+    int graphBottom = panelY + panelHeight - HUD_MARGIN;
+    for (int i = 0; i < numFrames; ++i) {
+        int barHeight = frameTimes[i] / (2 * frameBudgetMs) * HUD_GRAPH_HEIGHT;
+        barHeight = barHeight > HUD_GRAPH_HEIGHT ? HUD_GRAPH_HEIGHT : barHeight;
+        uint32_t color = frameTimes[i] > frameBudgetMs ? 0xFFFF4040 : 0xFF40FF40;
+        fillRect(colorBuffer, width, height, graphX + i * HUD_GRAPH_BAR_WIDTH, graphBottom - barHeight,
+                 HUD_GRAPH_BAR_WIDTH, barHeight, color);
+    }
+    fillRect(colorBuffer, width, height, graphX, graphBottom - HUD_GRAPH_HEIGHT / 2,
+             PROFILE_HISTORY * HUD_GRAPH_BAR_WIDTH, 1, 0xFFFFFFFF);
+}
@@ -0,0 +1,14 @@
+#ifndef RAYCASTING_HUD_H
+#define RAYCASTING_HUD_H
+
+#include <stdint.h>
+
+// Software overlay of the profiler: rolling average of every stage and a frame time graph,
+// drawn straight into an ARGB8888 buffer in the top right corner.
+void drawProfilerHud(uint32_t *colorBuffer, int width, int height);
+
+// Draws text with the built-in 3x5 font, scaled up; digits, letters and . : - / only.
+void drawHudText(uint32_t *colorBuffer, int width, int height, int x, int y, const char *text, uint32_t color,
+                 int scale);
+
+#endif //RAYCASTING_HUD_H
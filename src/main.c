@@ -4,33 +4,50 @@
 #include <zconf.h>
 
 #include "constants.h"
-#include "textures.h"
+#include "raycaster.h"
+#include "multiview.h"
+#include "collision.h"
+#include "profiler.h"
+#include "hud.h"
+#include "minimap.h"
 
 /* GLOBAL VARIABLES */
-const int map[MAP_NUM_ROWS][MAP_NUM_COLS] = {
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1, 1, 1, 1, 1, 1, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 2, 2, 0, 3, 0, 4, 0, 5, 0, 6, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 1},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
-        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
-        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 5, 5, 5, 5, 5, 5}
-};
-
 SDL_Window *window = NULL;
 SDL_Renderer *renderer = NULL;
 int isGameRunnig = FALSE;
 int ticksLastFrame;
-uint32_t *colorBuffer = NULL;
 SDL_Texture *colorBufferTexture = NULL;
-Uint32 *wallTexture = NULL;
-Uint32 *textures[NUM_TEXTURES];
+SDL_Texture *miniMapTexture = NULL; // static tile layer, redrawn when the map revision changes
+int miniMapRevision = -1;
+SDL_Rect *miniMapTiles = NULL;
+float miniMapScale;
+struct World *world = NULL;
+struct Raycaster *rc = NULL;
+struct ThreadPool *pool = NULL;
+int isHudVisible = FALSE;
+int isSoftwareMiniMap = FALSE; // composite the minimap into the color buffer instead of drawing it with SDL
+uint64_t frameStart;
+
+// what the last presented frame showed, nothing is rendered again until some of it changes
+struct FrameState {
+    struct Camera camera;
+    int mapRevision;
+    int spriteRevision;
+    int renderMode;
+    int isSoftwareMiniMap;
+} presentedFrame;
+int isFrameDirty = TRUE; // forces the next frame, for the window contents lost or the renderer reset
+int isIdle = FALSE;      // the last frame was skipped, wait for events instead of polling
+int renderMode = RENDER_MODE_FULL;
+
+// Pipelined loop, toggled with P: the pool renders the next frame into rc while this thread
+// presents the previous one from nextRc, one frame in flight at most.
+int isPipelined = FALSE;
+int isFrameInFlight = FALSE;
+struct Raycaster *nextRc = NULL;
+uint64_t inputTime;         // oldest input not rendered yet, for the input to photon latency
+uint64_t inFlightInputTime; // oldest input of the frame in flight
+uint64_t inFlightFrameStart; // when the update of the frame in flight began, frameStart moves on
 
 struct Player {
     float x;
@@ -44,22 +61,9 @@ struct Player {
     float turnSpeed;
 } player;
 
-struct Ray {
-    float rayAngle;
-    float wallHitX;
-    float wallHitY;
-    float distance;
-    int wasHitVertical;
-    int isRayFacingUp;
-    int isRayFacingDown;
-    int isRayFacingLeft;
-    int isRayFacingRight;
-    int wallHitContent;
-} rays[NUM_RAYS];
-
 int initializeWindow();
 
-void setup();
+int setup();
 
 void processInput();
 
@@ -71,32 +75,45 @@ void destroyWindow();
 
 void renderMap();
 
-void renderPlayer();
+void renderMapTiles();
+
+void renderPlayer(const struct Camera *camera);
 
 void movePlayer(float time);
 
-int mapHasWallAt(float x, float y);
+void renderColorBuffer(struct Raycaster *frame);
 
-void castAllRays();
+void presentFrame(struct Raycaster *frame, uint64_t frameInputTime, uint64_t frameStartTime);
 
-void castRay(float rayAngle, int stripId);
+void renderPipelined();
 
-void clearColorBuffer();
+void populateWorld();
 
-void renderColorBuffer();
+void useDoor();
 
-void generate3DProjection();
+int hasFrameChanged();
 
 int main(void) {
     printf("Program is running...\n");
 
-    isGameRunnig = initializeWindow();
-    setup();
+    isGameRunnig = initializeWindow() && setup();
 
     while (isGameRunnig) {
+        uint64_t start = profileBegin();
         processInput();
+        profileEnd(PROFILE_INPUT, start);
+        if (isPipelined || isFrameInFlight) {
+            renderPipelined();
+            continue;
+        }
         update();
-        render();
+        isIdle = !hasFrameChanged();
+        if (!isIdle) {
+            render();
+        } else {
+            // the input changed nothing on screen, there is no latency to measure
+            inputTime = 0;
+        }
     }
 
     destroyWindow();
@@ -104,7 +121,17 @@ int main(void) {
 }
 
 void destroyWindow() {
-    free(colorBuffer);
+    destroyThreadPool(pool);
+    destroyRaycaster(rc);
+    destroyRaycaster(nextRc);
+    destroyWorld(world);
+    if (colorBufferTexture) {
+        SDL_DestroyTexture(colorBufferTexture);
+    }
+    if (miniMapTexture) {
+        SDL_DestroyTexture(miniMapTexture);
+    }
+    free(miniMapTiles);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -139,7 +166,7 @@ int initializeWindow() {
     return TRUE;
 }
 
-void setup() {
+int setup() {
     player.x = (float) WINDOW_WIDTH / 2;
     player.y = (float) WINDOW_HEIGHT / 2;
     player.width = 8;
@@ -150,7 +177,30 @@ void setup() {
     player.walkSpeed = 150; // in pixels
     player.turnSpeed = (float) (90.0 * (PI / 180)); // radians
 
-    colorBuffer = malloc(sizeof(Uint32) * (Uint32) WINDOW_WIDTH * (Uint32) WINDOW_HEIGHT);
+    world = createWorld(&defaultMap[0][0], MAP_NUM_COLS, MAP_NUM_ROWS);
+    if (!world) {
+        fprintf(stderr, "Error creating the world\n");
+        return FALSE;
+    }
+    // the PVS is normally built offline by pvsbuild, small maps can afford building it here
+    worldLoadPvs(world, PVS_FILE);
+    populateWorld();
+
+    rc = createRaycaster(world, WINDOW_WIDTH, WINDOW_HEIGHT);
+    nextRc = createRaycaster(world, WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (!rc || !nextRc) {
+        fprintf(stderr, "Error creating the raycaster\n");
+        return FALSE;
+    }
+    // turning in place then only casts the columns that come into view
+    rc->isIncremental = TRUE;
+    nextRc->isIncremental = TRUE;
+    pool = createThreadPool(0);
+    if (!pool) {
+        fprintf(stderr, "Error creating the thread pool\n");
+        return FALSE;
+    }
+
     // create SDL texture to display a color buffer
     colorBufferTexture = SDL_CreateTexture(
             renderer,
@@ -159,34 +209,78 @@ void setup() {
             WINDOW_WIDTH,
             WINDOW_HEIGHT
     );
+    if (!colorBufferTexture) {
+        fprintf(stderr, "Error creating the color buffer texture\n");
+        return FALSE;
+    }
 
-    /*// allocate memory for texture
-    wallTexture = (Uint32 *) malloc(sizeof(Uint32) * (Uint32) TEXTURE_WIDTH * (Uint32) TEXTURE_HEIGHT);
-    // create a procedure texture
-    for (int x = 0; x < TEXTURE_WIDTH; ++x) {
-        for (int y = 0; y < TEXTURE_HEIGHT; ++y) {
-            wallTexture[(TEXTURE_WIDTH * y) + x] = (x % 8 && y % 8) ? 0xFF0000FF : 0xFF000000;
-        }
-    }*/
-
-    textures[0] = (Uint32 *)REDBRICK_TEXTURE;
-    textures[1] = (Uint32 *)PURPLESTONE_TEXTURE;
-    textures[2] = (Uint32 *)MOSSYSTONE_TEXTURE;
-    textures[3] = (Uint32 *)GRAYSTONE_TEXTURE;
-    textures[4] = (Uint32 *)COLORSTONE_TEXTURE;
-    textures[5] = (Uint32 *)BLUESTONE_TEXTURE;
-    textures[6] = (Uint32 *)WOOD_TEXTURE;
-    textures[7] = (Uint32 *)EAGLE_TEXTURE;
+    // the minimap never grows past MAX_MINI_MAP_SIZE, whatever the size of the map
+    const struct Map *map = &world->map;
+    int mapSize = map->numCols > map->numRows ? map->numCols * TILE_SIZE : map->numRows * TILE_SIZE;
+    miniMapScale = mapSize * MINI_MAP_SCALE_FACTOR > MAX_MINI_MAP_SIZE
+                   ? (float) MAX_MINI_MAP_SIZE / mapSize
+                   : MINI_MAP_SCALE_FACTOR;
+    miniMapTiles = malloc(sizeof(SDL_Rect) * map->numCols * map->numRows);
+    if (!miniMapTiles) {
+        fprintf(stderr, "Error allocating the minimap\n");
+        return FALSE;
+    }
+    // without render target support the tiles are drawn every frame instead
+    miniMapTexture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET,
+            (int) ceil(map->numCols * TILE_SIZE * miniMapScale),
+            (int) ceil(map->numRows * TILE_SIZE * miniMapScale)
+    );
+    return TRUE;
+}
+
+void populateWorld() {
+    // static decorations in the middle of a few empty cells
+    worldAddSprite(world, 2.5f * TILE_SIZE, 2.5f * TILE_SIZE, 0, FALSE);
+    worldAddSprite(world, 2.5f * TILE_SIZE, 10.5f * TILE_SIZE, 0, FALSE);
+    worldAddSprite(world, 10.5f * TILE_SIZE, 10.5f * TILE_SIZE, 0, FALSE);
+    worldAddSprite(world, 17.5f * TILE_SIZE, 2.5f * TILE_SIZE, 0, FALSE);
+    worldAddSprite(world, 17.5f * TILE_SIZE, 10.5f * TILE_SIZE, 0, FALSE);
+
+    // dynamic entities wandering around the map
+    for (int i = 0; i < 16; ++i) {
+        int index = worldAddSprite(world, (3.5f + i) * TILE_SIZE, 7.5f * TILE_SIZE, 1, TRUE);
+        float angle = i * (TWO_PI / 16);
+        world->sprites.sprites[index].velocityX = cos(angle) * 60;
+        world->sprites.sprites[index].velocityY = sin(angle) * 60;
+    }
 }
 
 void processInput() {
     SDL_Event event;
-    SDL_PollEvent(&event);
+    // an idle loop sleeps until something happens instead of spinning through unchanged frames
+    int hasEvent = isIdle ? SDL_WaitEventTimeout(&event, IDLE_WAIT_TIME) : SDL_PollEvent(&event);
+    if (!hasEvent) {
+        return;
+    }
+    if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+        if (!inputTime) {
+            inputTime = profileBegin();
+        }
+    }
     switch (event.type) {
         case SDL_QUIT: {
             isGameRunnig = FALSE;
             break;
         }
+        case SDL_RENDER_TARGETS_RESET: {
+            // the renderer lost the content of the cached minimap
+            miniMapRevision = -1;
+            isFrameDirty = TRUE;
+            break;
+        }
+        case SDL_WINDOWEVENT: {
+            // shown, exposed, resized... the window may need its frame again
+            isFrameDirty = TRUE;
+            break;
+        }
         case SDL_KEYDOWN: {
             if (event.key.keysym.sym == SDLK_ESCAPE) {
                 isGameRunnig = FALSE;
@@ -206,6 +300,34 @@ void processInput() {
             if (event.key.keysym.sym == SDLK_LEFT) {
                 player.turnDirection = -1;
             }
+            if (event.key.keysym.sym == SDLK_SPACE) {
+                useDoor();
+            }
+            if (event.key.keysym.sym == SDLK_m) {
+                renderMode = (renderMode + 1) % NUM_RENDER_MODES;
+            }
+            if (event.key.keysym.sym == SDLK_F1) {
+                // the profiler only runs while its HUD is up
+                isHudVisible = !isHudVisible;
+                isFrameDirty = TRUE;
+                profilerEnable(isHudVisible);
+            }
+            if (event.key.keysym.sym == SDLK_p) {
+                isPipelined = !isPipelined;
+                isFrameDirty = TRUE;
+            }
+            if (event.key.keysym.sym == SDLK_n) {
+                isSoftwareMiniMap = !isSoftwareMiniMap;
+            }
+            if (event.key.keysym.sym == SDLK_f) {
+                // frozen wandering sprites let the stock scene go idle between inputs
+                world->areSpritesPaused = !world->areSpritesPaused;
+            }
+            if (event.key.keysym.sym == SDLK_F2) {
+                if (profilerIsEnabled() && profileWriteChromeTrace("trace.json")) {
+                    printf("Wrote trace.json\n");
+                }
+            }
             break;
         }
         case SDL_KEYUP: {
@@ -227,317 +349,284 @@ void processInput() {
 }
 
 void update() {
-    while (SDL_GetTicks() < (ticksLastFrame + FRAME_TIME_LENGTH)) {}
+    // sleep rather than spin until the frame time is up
+    int waitTime = ticksLastFrame + FRAME_TIME_LENGTH - (int) SDL_GetTicks();
+    if (waitTime > 0) {
+        SDL_Delay(waitTime);
+    }
 
-    float deltaTime = (float) (SDL_GetTicks() - ticksLastFrame) / 1000.0f;
+    // the first frame after idling moves by one frame, not by the whole time spent waiting
+    float deltaTime = isIdle ? FRAME_TIME_LENGTH / 1000.0f : (float) (SDL_GetTicks() - ticksLastFrame) / 1000.0f;
     ticksLastFrame = SDL_GetTicks();
+    frameStart = profileBegin();
 
+    uint64_t start = profileBegin();
     movePlayer(deltaTime);
+    profileEnd(PROFILE_MOVE, start);
+
+    start = profileBegin();
+    updateWorld(world, deltaTime);
+    profileEnd(PROFILE_WORLD, start);
 
-    castAllRays();
+    rc->camera.x = player.x;
+    rc->camera.y = player.y;
+    rc->camera.angle = player.rotatingAngle;
+    rc->renderMode = renderMode;
 }
 
-void castAllRays() {
-    // start first ray subtracting half of our FOV
-    float rayAngle = player.rotatingAngle - (FOV_ANGLE / 2);
+int hasFrameChanged() {
+    struct FrameState frame = {
+            rc->camera,
+            world->map.revision,
+            world->spriteRevision,
+            rc->renderMode,
+            isSoftwareMiniMap
+    };
+    // the profiler HUD shows the frame times, it changes every frame
+    int hasChanged = isFrameDirty || isHudVisible ||
+                     frame.camera.x != presentedFrame.camera.x || frame.camera.y != presentedFrame.camera.y ||
+                     frame.camera.angle != presentedFrame.camera.angle ||
+                     frame.mapRevision != presentedFrame.mapRevision ||
+                     frame.spriteRevision != presentedFrame.spriteRevision ||
+                     frame.renderMode != presentedFrame.renderMode ||
+                     frame.isSoftwareMiniMap != presentedFrame.isSoftwareMiniMap;
+    presentedFrame = frame;
+    isFrameDirty = FALSE;
+    return hasChanged;
+}
 
-    for (int stripId = 0; stripId < NUM_RAYS; stripId++) {
-        castRay(rayAngle, stripId);
-        rayAngle += FOV_ANGLE / NUM_RAYS;
+void useDoor() {
+    // toggle the door right in front of the player
+    int col = (int) floor((player.x + cos(player.rotatingAngle) * TILE_SIZE) / TILE_SIZE);
+    int row = (int) floor((player.y + sin(player.rotatingAngle) * TILE_SIZE) / TILE_SIZE);
+    int door = findDoor(&world->map, col, row);
+    if (door >= 0) {
+        toggleDoor(&world->map, door);
     }
 }
 
-float normalizeAngle(float angle) {
-    angle = remainder(angle, TWO_PI);
-    if (angle < 0) {
-        angle = TWO_PI + angle;
+void renderRays(const struct Raycaster *frame) {
+    // one translucent fan over a subset of the rays instead of a line per ray, the center first,
+    // with room to close the outline
+    SDL_FPoint points[MAX_MINI_MAP_RAYS + 3];
+    int rayStep = (frame->width + MAX_MINI_MAP_RAYS - 1) / MAX_MINI_MAP_RAYS;
+    SDL_Color rayColor = {255, 0, 0, 128};
+
+    points[0].x = miniMapScale * frame->camera.x;
+    points[0].y = miniMapScale * frame->camera.y;
+    int numPoints = 1;
+    for (int i = 0; i < frame->width; i += rayStep) {
+        // always end on the last ray, so the fan spans the whole FOV
+        int ray = i + rayStep >= frame->width ? frame->width - 1 : i;
+        points[numPoints].x = miniMapScale * frame->rays[ray].wallHitX;
+        points[numPoints].y = miniMapScale * frame->rays[ray].wallHitY;
+        numPoints++;
+    }
+    if (numPoints < 3) {
+        return;
     }
-    return angle;
-}
 
-float distanceBetweenPoints(float x1, float y1, float x2, float y2) {
-    return sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_Vertex vertices[MAX_MINI_MAP_RAYS + 2];
+    int indices[3 * (MAX_MINI_MAP_RAYS + 1)];
+    for (int i = 0; i < numPoints; ++i) {
+        vertices[i].position = points[i];
+        vertices[i].color = rayColor;
+        vertices[i].tex_coord.x = 0;
+        vertices[i].tex_coord.y = 0;
+    }
+    int numIndices = 0;
+    for (int i = 1; i < numPoints - 1; ++i) {
+        indices[numIndices++] = 0;
+        indices[numIndices++] = i;
+        indices[numIndices++] = i + 1;
+    }
+    SDL_RenderGeometry(renderer, NULL, vertices, numPoints, indices, numIndices);
+#else
+    // older SDL has no SDL_Vertex nor geometry, draw the outline of the fan as a single polyline
+    points[numPoints] = points[0];
+    SDL_SetRenderDrawColor(renderer, rayColor.r, rayColor.g, rayColor.b, 255);
+    SDL_RenderDrawLinesF(renderer, points, numPoints + 1);
+#endif
 }
 
-void castRay(float rayAngle, int stripId) {
-    rayAngle = normalizeAngle(rayAngle);
-
-    int isRayFacingDown = rayAngle > 0 && rayAngle < PI;
-    int isRayFacingUp = !isRayFacingDown;
-
-    int isRayFacingRight = rayAngle < PI / 2 || rayAngle > PI * 3 / 2;
-    int isRayFacingLeft = !isRayFacingRight;
-
-    float xintercept, yintercept;
-    float xstep, ystep;
-
-    ///////////////////////////////////////////
-    // HORIZONTAL RAY-GRID INTERSECTION CODE
-    ///////////////////////////////////////////
-    int foundHorzWallHit = FALSE;
-    float horzWallHitX = 0;
-    float horzWallHitY = 0;
-    int horzWallContent = 0;
-
-    // Find the y-coordinate of the closest horizontal grid intersection
-    yintercept = floor(player.y / TILE_SIZE) * TILE_SIZE;
-    yintercept += isRayFacingDown ? TILE_SIZE : 0;
-
-    // Find the x-coordinate of the closest horizontal grid intersection
-    xintercept = player.x + (yintercept - player.y) / tan(rayAngle);
-
-    // Calculate the increment xstep and ystep
-    ystep = TILE_SIZE;
-    ystep *= isRayFacingUp ? -1 : 1;
-
-    xstep = TILE_SIZE / tan(rayAngle);
-    xstep *= (isRayFacingLeft && xstep > 0) ? -1 : 1;
-    xstep *= (isRayFacingRight && xstep < 0) ? -1 : 1;
+void render() {
+    uint64_t frameInputTime = inputTime;
+    inputTime = 0;
 
-    float nextHorzTouchX = xintercept;
-    float nextHorzTouchY = yintercept;
+    // casts and draws the 3D view across all cores
+    renderViews(pool, &rc, 1);
+    presentFrame(rc, frameInputTime, frameStart);
+}
 
-    // Increment xstep and ystep until we find a wall
-    while (nextHorzTouchX >= 0 && nextHorzTouchX <= WINDOW_WIDTH && nextHorzTouchY >= 0 &&
-           nextHorzTouchY <= WINDOW_HEIGHT) {
-        float xToCheck = nextHorzTouchX;
-        float yToCheck = nextHorzTouchY + (isRayFacingUp ? -1 : 0);
+static void renderFrameJob(void *context, int jobIndex) {
+    struct Raycaster *frame = context;
+    (void) jobIndex;
+    renderViews(pool, &frame, 1);
+}
 
-        if (mapHasWallAt(xToCheck, yToCheck)) {
-            // found a wall hit
-            horzWallHitX = nextHorzTouchX;
-            horzWallHitY = nextHorzTouchY;
-            horzWallContent = map[(int) floor(yToCheck / TILE_SIZE)][(int) floor(xToCheck / TILE_SIZE)];
-            foundHorzWallHit = TRUE;
-            break;
-        } else {
-            nextHorzTouchX += xstep;
-            nextHorzTouchY += ystep;
-        }
+void renderPipelined() {
+    // the world must not change under the frame in flight, wait for it before updating
+    struct Raycaster *finished = NULL;
+    uint64_t finishedInputTime = inFlightInputTime;
+    uint64_t finishedFrameStart = inFlightFrameStart;
+    if (isFrameInFlight) {
+        threadPoolWaitAsync(pool);
+        isFrameInFlight = FALSE;
+        finished = rc;
+        rc = nextRc;
+        nextRc = finished;
     }
 
-    ///////////////////////////////////////////
-    // VERTICAL RAY-GRID INTERSECTION CODE
-    ///////////////////////////////////////////
-    int foundVertWallHit = FALSE;
-    float vertWallHitX = 0;
-    float vertWallHitY = 0;
-    int vertWallContent = 0;
-
-    // Find the x-coordinate of the closest horizontal grid intersection
-    xintercept = floor(player.x / TILE_SIZE) * TILE_SIZE;
-    xintercept += isRayFacingRight ? TILE_SIZE : 0;
-
-    // Find the y-coordinate of the closest horizontal grid intersection
-    yintercept = player.y + (xintercept - player.x) * tan(rayAngle);
-
-    // Calculate the increment xstep and ystep
-    xstep = TILE_SIZE;
-    xstep *= isRayFacingLeft ? -1 : 1;
-
-    ystep = TILE_SIZE * tan(rayAngle);
-    ystep *= (isRayFacingUp && ystep > 0) ? -1 : 1;
-    ystep *= (isRayFacingDown && ystep < 0) ? -1 : 1;
-
-    float nextVertTouchX = xintercept;
-    float nextVertTouchY = yintercept;
-
-    // Increment xstep and ystep until we find a wall
-    while (nextVertTouchX >= 0 && nextVertTouchX <= WINDOW_WIDTH && nextVertTouchY >= 0 &&
-           nextVertTouchY <= WINDOW_HEIGHT) {
-        float xToCheck = nextVertTouchX + (isRayFacingLeft ? -1 : 0);
-        float yToCheck = nextVertTouchY;
-
-        if (mapHasWallAt(xToCheck, yToCheck)) {
-            // found a wall hit
-            vertWallHitX = nextVertTouchX;
-            vertWallHitY = nextVertTouchY;
-            vertWallContent = map[(int) floor(yToCheck / TILE_SIZE)][(int) floor(xToCheck / TILE_SIZE)];
-            foundVertWallHit = TRUE;
-            break;
+    if (isPipelined) {
+        update();
+        if (hasFrameChanged()) {
+            inFlightInputTime = inputTime;
+            inFlightFrameStart = frameStart;
+            inputTime = 0;
+            threadPoolRunAsync(pool, renderFrameJob, rc);
+            isFrameInFlight = TRUE;
         } else {
-            nextVertTouchX += xstep;
-            nextVertTouchY += ystep;
+            inputTime = 0;
         }
     }
 
-    // Calculate both horizontal and vertical hit distances and choose the smallest one
-    float horzHitDistance = foundHorzWallHit
-                            ? distanceBetweenPoints(player.x, player.y, horzWallHitX, horzWallHitY)
-                            : INT_MAX;
-    float vertHitDistance = foundVertWallHit
-                            ? distanceBetweenPoints(player.x, player.y, vertWallHitX, vertWallHitY)
-                            : INT_MAX;
-
-    if (vertHitDistance < horzHitDistance) {
-        rays[stripId].distance = vertHitDistance;
-        rays[stripId].wallHitX = vertWallHitX;
-        rays[stripId].wallHitY = vertWallHitY;
-        rays[stripId].wallHitContent = vertWallContent;
-        rays[stripId].wasHitVertical = TRUE;
-    } else {
-        rays[stripId].distance = horzHitDistance;
-        rays[stripId].wallHitX = horzWallHitX;
-        rays[stripId].wallHitY = horzWallHitY;
-        rays[stripId].wallHitContent = horzWallContent;
-        rays[stripId].wasHitVertical = FALSE;
-    }
-    rays[stripId].rayAngle = rayAngle;
-    rays[stripId].isRayFacingDown = isRayFacingDown;
-    rays[stripId].isRayFacingUp = isRayFacingUp;
-    rays[stripId].isRayFacingLeft = isRayFacingLeft;
-    rays[stripId].isRayFacingRight = isRayFacingRight;
-}
-
-void renderRays() {
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-    for (int i = 0; i < NUM_RAYS; i++) {
-        SDL_RenderDrawLine(
-                renderer,
-                MINI_MAP_SCALE_FACTOR * player.x,
-                MINI_MAP_SCALE_FACTOR * player.y,
-                MINI_MAP_SCALE_FACTOR * rays[i].wallHitX,
-                MINI_MAP_SCALE_FACTOR * rays[i].wallHitY
-        );
+    // presenting the last frame overlaps with the rendering of the next one
+    if (finished) {
+        presentFrame(finished, finishedInputTime, finishedFrameStart);
     }
+    isIdle = !isFrameInFlight;
 }
 
-void render() {
+void presentFrame(struct Raycaster *frame, uint64_t frameInputTime, uint64_t frameStartTime) {
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
 
-    generate3DProjection();
-    renderColorBuffer();
-    clearColorBuffer(0xFF000000);
-
-    // render minimap
-    renderMap();
-    renderRays();
-    renderPlayer();
+    uint64_t start = profileBegin();
+    renderColorBuffer(frame);
+    profileEnd(PROFILE_COLOR_BUFFER, start);
+
+    start = profileBegin();
+    clearColorBuffer(frame, 0xFF000000);
+    profileEnd(PROFILE_CLEAR, start);
+
+    // render minimap, the player where the frame saw it: the pipelined loop has already moved on
+    if (!isSoftwareMiniMap) {
+        start = profileBegin();
+        renderMap();
+        renderRays(frame);
+        renderPlayer(&frame->camera);
+        profileEnd(PROFILE_MINIMAP, start);
+    }
 
     SDL_RenderPresent(renderer);
+    profileEnd(PROFILE_LATENCY, frameInputTime);
+    profileEnd(PROFILE_FRAME, frameStartTime);
+    profileFrameEnd();
 }
 
-void generate3DProjection() {
-    for (int i = 0; i < NUM_RAYS; ++i) {
-        float normDistance = rays[i].distance * cos(rays[i].rayAngle - player.rotatingAngle);
-        float distanceProjPlane = (WINDOW_WIDTH / 2) / tan(FOV_ANGLE / 2);
-        float projectedWallHeight = (TILE_SIZE / normDistance) * distanceProjPlane;
-
-        int wallStripHeight = projectedWallHeight;
-
-        int wallTopPixel = (WINDOW_HEIGHT / 2) - (wallStripHeight / 2);
-        wallTopPixel = wallTopPixel < 0 ? 0 : wallTopPixel;
-
-        int wallBottomPixel = (WINDOW_HEIGHT / 2) + (wallStripHeight / 2);
-        wallBottomPixel = wallBottomPixel > WINDOW_HEIGHT ? WINDOW_HEIGHT : wallBottomPixel;
-
-        // rendering the ceiling
-        for (int c = 0; c < wallTopPixel; ++c) {
-            colorBuffer[WINDOW_WIDTH * c + i] = 0xFF333333;
-        }
-        // rendering floor
-        for (int c = wallBottomPixel; c < WINDOW_HEIGHT; ++c) {
-            colorBuffer[WINDOW_WIDTH * c + i] = 0xFF777777;
-        }
-        // rendering the walls
-        int textureOffsetX;
-        if (rays[i].wasHitVertical) {
-            textureOffsetX = (int)rays[i].wallHitY % TILE_SIZE;
-        } else {
-            textureOffsetX = (int)rays[i].wallHitX % TILE_SIZE;
-        }
-        int textNum = rays[i].wallHitContent - 1;
-
-        for (int y = wallTopPixel; y < wallBottomPixel; ++y) {
-            int distanceFromTop = y + wallStripHeight / 2 - WINDOW_HEIGHT / 2;
-            int textureOffsetY = distanceFromTop * ((float) TEXTURE_HEIGHT / wallStripHeight);
-            // set the color of the wall based on the texture in memory
-            // Uint32 texelColor = wallTexture[TEXTURE_WIDTH * textureOffsetY + textureOffsetX];
-            Uint32 texelColor = textures[textNum][TEXTURE_WIDTH * textureOffsetY + textureOffsetX];
-
-            colorBuffer[WINDOW_WIDTH * y + i] = texelColor;
+void renderColorBuffer(struct Raycaster *frame) {
+    if (frame->renderMode == RENDER_MODE_DEPTH && !isSoftwareMiniMap && !isHudVisible) {
+        // nothing but the rays to show, the minimap draws them
+        return;
+    }
+    if (frame->renderMode == RENDER_MODE_GRAY) {
+        // the streaming texture is ARGB, so expand the gray frame for display
+        for (int i = 0; i < frame->width * frame->height; ++i) {
+            frame->colorBuffer[i] = 0xFF000000 | frame->grayBuffer[i] * 0x010101;
         }
     }
-
-}
-
-void renderColorBuffer() {
+    if (frame->renderMode == RENDER_MODE_INDEXED) {
+        expandIndexBuffer(frame);
+    }
+    if (isSoftwareMiniMap) {
+        uint64_t start = profileBegin();
+        drawMiniMap(frame);
+        profileEnd(PROFILE_MINIMAP, start);
+    }
+    if (isHudVisible) {
+        uint64_t start = profileBegin();
+        drawProfilerHud(frame->colorBuffer, frame->width, frame->height);
+        profileEnd(PROFILE_HUD, start);
+    }
     SDL_UpdateTexture(
             colorBufferTexture,
             NULL,
-            colorBuffer,
+            frame->colorBuffer,
             sizeof(Uint32) * WINDOW_WIDTH
     );
     SDL_RenderCopy(renderer, colorBufferTexture, NULL, NULL);
 }
 
-void clearColorBuffer(Uint32 color) {
-    for (int y = 0; y < WINDOW_HEIGHT; ++y) {
-        for (int x = 0; x < WINDOW_WIDTH; ++x) {
-            colorBuffer[WINDOW_WIDTH * y + x] = color;
-        }
-    }
-}
-
 void movePlayer(float deltaTime) {
     player.rotatingAngle += player.turnDirection * player.turnSpeed * deltaTime;
     float moveStep = player.walkDirection * player.walkSpeed * deltaTime;
 
-    float newPlayerX = player.x + cos(player.rotatingAngle) * moveStep;
-    float newPlayerY = player.y + sin(player.rotatingAngle) * moveStep;
-
-    // TODO: perform a wall collision
-    if (!mapHasWallAt(newPlayerX, newPlayerY)) {
-        player.x = newPlayerX;
-        player.y = newPlayerY;
-    }
+    float moveX = cos(player.rotatingAngle) * moveStep;
+    float moveY = sin(player.rotatingAngle) * moveStep;
 
+    // slide along the walls, keeping the whole player body out of them
+    collideMove(&world->map, &player.x, &player.y, player.width / 2, moveX, moveY);
 }
 
-int mapHasWallAt(float x, float y) {
-    if (x < 0 || x > WINDOW_WIDTH || y < 0 || y > WINDOW_HEIGHT) {
-        return TRUE;
-    }
-    int mapIndexX = floor(x / TILE_SIZE);
-    int mapIndexY = floor(y / TILE_SIZE);
-    return map[mapIndexY][mapIndexX] != 0;
-}
-
-void renderPlayer() {
+void renderPlayer(const struct Camera *camera) {
     SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
     SDL_Rect playerRect = {
-            (player.x - player.width / 2) * MINI_MAP_SCALE_FACTOR,
-            (player.y - player.height / 2) * MINI_MAP_SCALE_FACTOR,
-            player.width * MINI_MAP_SCALE_FACTOR,
-            player.height * MINI_MAP_SCALE_FACTOR
+            (camera->x - player.width / 2) * miniMapScale,
+            (camera->y - player.height / 2) * miniMapScale,
+            player.width * miniMapScale,
+            player.height * miniMapScale
     };
     SDL_RenderFillRect(renderer, &playerRect);
     SDL_RenderDrawLine(
             renderer,
-            MINI_MAP_SCALE_FACTOR * player.x,
-            MINI_MAP_SCALE_FACTOR * player.y,
-            MINI_MAP_SCALE_FACTOR * player.x + cos(player.rotatingAngle) * 40,
-            MINI_MAP_SCALE_FACTOR * player.y + sin(player.rotatingAngle) * 40
+            miniMapScale * camera->x,
+            miniMapScale * camera->y,
+            miniMapScale * camera->x + cos(camera->angle) * 40,
+            miniMapScale * camera->y + sin(camera->angle) * 40
     );
 }
 
-void renderMap() {
-    for (int i = 0; i < MAP_NUM_ROWS; ++i) {
-        for (int j = 0; j < MAP_NUM_COLS; ++j) {
-            int tileX = j * TILE_SIZE;
-            int tileY = i * TILE_SIZE;
-            int tileColor = map[i][j] != 0 ? 255 : 0;
-
-            SDL_SetRenderDrawColor(renderer, tileColor, tileColor, tileColor, 255);
-            SDL_Rect mapTileRect = {
-                    tileX * MINI_MAP_SCALE_FACTOR,
-                    tileY * MINI_MAP_SCALE_FACTOR,
-                    TILE_SIZE * MINI_MAP_SCALE_FACTOR,
-                    TILE_SIZE * MINI_MAP_SCALE_FACTOR
-            };
-            SDL_RenderFillRect(renderer, &mapTileRect);
+void renderMapTiles() {
+    const struct Map *map = &world->map;
+    SDL_Rect background = {0, 0, map->numCols * TILE_SIZE * miniMapScale, map->numRows * TILE_SIZE * miniMapScale};
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderFillRect(renderer, &background);
+
+    // every wall tile in one batch over the black background
+    int numTiles = 0;
+    for (int i = 0; i < map->numRows; ++i) {
+        for (int j = 0; j < map->numCols; ++j) {
+            if (map->cells[map->numCols * i + j] == 0) {
+                continue;
+            }
+            SDL_Rect *mapTileRect = &miniMapTiles[numTiles++];
+            mapTileRect->x = j * TILE_SIZE * miniMapScale;
+            mapTileRect->y = i * TILE_SIZE * miniMapScale;
+            mapTileRect->w = TILE_SIZE * miniMapScale;
+            mapTileRect->h = TILE_SIZE * miniMapScale;
         }
     }
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderFillRects(renderer, miniMapTiles, numTiles);
 }
 
+void renderMap() {
+    if (!miniMapTexture) {
+        renderMapTiles();
+        return;
+    }
+    if (miniMapRevision != world->map.revision) {
+        SDL_SetRenderTarget(renderer, miniMapTexture);
+        renderMapTiles();
+        SDL_SetRenderTarget(renderer, NULL);
+        miniMapRevision = world->map.revision;
+    }
+    SDL_Rect miniMapRect = {
+            0,
+            0,
+            ceil(world->map.numCols * TILE_SIZE * miniMapScale),
+            ceil(world->map.numRows * TILE_SIZE * miniMapScale)
+    };
+    SDL_RenderCopy(renderer, miniMapTexture, NULL, &miniMapRect);
+}
@@ -0,0 +1,229 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map.h"
+
+const int defaultMap[MAP_NUM_ROWS][MAP_NUM_COLS] = {
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 ,1, 1, 1, 1, 1, 1, 1},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9, 0, 0, 0, 1},
+        {1, 0, 0, 0, 2, 2, 0, 3, 0, 4, 0, 5, 0, 6, 0, 0, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0, 0, 1},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
+        {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 5},
+        {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 5, 5, 5, 5, 5, 5}
+};
+
+static void updateOccupancy(struct Map *map, int col, int row) {
+    int cell = row * map->numCols + col;
+    int content = map->cells[cell];
+    // a door only stops blocking once fully open
+    int isSolid = content == DOOR_CELL ? map->doors[map->doorAt[cell]].openAmount < 1 : content != 0;
+    if (isSolid) {
+        map->occupancy[cell / 32] |= 1u << (cell % 32);
+    } else {
+        map->occupancy[cell / 32] &= ~(1u << (cell % 32));
+    }
+}
+
+static int addDoor(struct Map *map, int col, int row) {
+    if (map->numDoors >= MAX_DOORS) {
+        return -1;
+    }
+    struct Door *door = &map->doors[map->numDoors];
+    door->col = col;
+    door->row = row;
+    // the panel spans between the two walls around it
+    door->isVertical = mapIsSolidCell(map, col, row - 1) || mapIsSolidCell(map, col, row + 1);
+    door->openAmount = 0;
+    door->direction = 0;
+    map->doorAt[row * map->numCols + col] = map->numDoors;
+    return map->numDoors++;
+}
+
+static void removeDoor(struct Map *map, int index) {
+    struct Door *door = &map->doors[index];
+    map->doorAt[door->row * map->numCols + door->col] = -1;
+    *door = map->doors[map->numDoors - 1];
+    map->numDoors--;
+    if (index < map->numDoors) {
+        map->doorAt[door->row * map->numCols + door->col] = index;
+    }
+}
+
+int initMap(struct Map *map, const int *cells, int numCols, int numRows) {
+    int numCells = numCols * numRows;
+    map->numCols = numCols;
+    map->numRows = numRows;
+    map->cells = malloc(sizeof(int) * numCells);
+    map->occupancy = calloc((numCells + 31) / 32, sizeof(uint32_t));
+    map->doorAt = malloc(sizeof(int) * numCells);
+    map->numDoors = 0;
+    map->revision = 0;
+    if (!map->cells || !map->occupancy || !map->doorAt) {
+        freeMap(map);
+        return FALSE;
+    }
+    memcpy(map->cells, cells, sizeof(int) * numCells);
+
+    for (int cell = 0; cell < numCells; ++cell) {
+        map->doorAt[cell] = -1;
+    }
+    // walls first, so the door orientation can look at its neighbours
+    for (int cell = 0; cell < numCells; ++cell) {
+        if (map->cells[cell] != DOOR_CELL) {
+            updateOccupancy(map, cell % numCols, cell / numCols);
+        }
+    }
+    for (int cell = 0; cell < numCells; ++cell) {
+        if (map->cells[cell] == DOOR_CELL) {
+            if (addDoor(map, cell % numCols, cell / numCols) < 0) {
+                map->cells[cell] = 0;
+            }
+            updateOccupancy(map, cell % numCols, cell / numCols);
+        }
+    }
+    return TRUE;
+}
+
+void freeMap(struct Map *map) {
+    free(map->cells);
+    free(map->occupancy);
+    free(map->doorAt);
+    map->cells = NULL;
+    map->occupancy = NULL;
+    map->doorAt = NULL;
+}
+
+int mapIsSolidCell(const struct Map *map, int col, int row) {
+    if (col < 0 || col >= map->numCols || row < 0 || row >= map->numRows) {
+        return TRUE;
+    }
+    int cell = row * map->numCols + col;
+    return (map->occupancy[cell / 32] >> (cell % 32)) & 1;
+}
+
+int mapContentAt(const struct Map *map, int col, int row) {
+    if (col < 0 || col >= map->numCols || row < 0 || row >= map->numRows) {
+        return 1;
+    }
+    return map->cells[row * map->numCols + col];
+}
+
+int mapHasWallAt(const struct Map *map, float x, float y) {
+    // outside of the map is solid, its far edges included
+    if (x < 0 || x >= map->numCols * TILE_SIZE || y < 0 || y >= map->numRows * TILE_SIZE) {
+        return TRUE;
+    }
+    int mapIndexX = floor(x / TILE_SIZE);
+    int mapIndexY = floor(y / TILE_SIZE);
+    return mapIsSolidCell(map, mapIndexX, mapIndexY);
+}
+
+void setMapCell(struct Map *map, int col, int row, int content) {
+    if (col < 0 || col >= map->numCols || row < 0 || row >= map->numRows) {
+        return;
+    }
+    int cell = row * map->numCols + col;
+    if (map->cells[cell] == content) {
+        return;
+    }
+    if (map->cells[cell] == DOOR_CELL) {
+        removeDoor(map, map->doorAt[cell]);
+    }
+    map->cells[cell] = content;
+    if (content == DOOR_CELL && addDoor(map, col, row) < 0) {
+        map->cells[cell] = 0;
+    }
+    updateOccupancy(map, col, row);
+    map->revision++;
+}
+
+int findDoor(const struct Map *map, int col, int row) {
+    if (col < 0 || col >= map->numCols || row < 0 || row >= map->numRows) {
+        return -1;
+    }
+    return map->doorAt[row * map->numCols + col];
+}
+
+void toggleDoor(struct Map *map, int index) {
+    struct Door *door = &map->doors[index];
+    door->direction = door->direction > 0 || (door->direction == 0 && door->openAmount >= 1) ? -1 : +1;
+}
+
+int updateDoors(struct Map *map, float deltaTime) {
+    int hasMoved = FALSE;
+    for (int i = 0; i < map->numDoors; ++i) {
+        struct Door *door = &map->doors[i];
+        if (door->direction == 0) {
+            continue;
+        }
+        door->openAmount += door->direction * DOOR_OPEN_SPEED * deltaTime;
+        if (door->openAmount >= 1) {
+            door->openAmount = 1;
+            door->direction = 0;
+        } else if (door->openAmount <= 0) {
+            door->openAmount = 0;
+            door->direction = 0;
+        }
+        updateOccupancy(map, door->col, door->row);
+        hasMoved = TRUE;
+    }
+    if (hasMoved) {
+        map->revision++;
+    }
+    return hasMoved;
+}
+
+int mapDoorHit(const struct Map *map, int col, int row, float x, float y, float dirX, float dirY,
+               float *hitX, float *hitY) {
+    const struct Door *door = &map->doors[map->doorAt[row * map->numCols + col]];
+    float cellX = col * TILE_SIZE;
+    float cellY = row * TILE_SIZE;
+
+    // intersect the ray with the panel, which sits in the middle of the cell
+    float planeHitX, planeHitY, offset;
+    if (door->isVertical) {
+        if (dirX == 0) {
+            return FALSE;
+        }
+        planeHitX = cellX + TILE_SIZE / 2;
+        planeHitY = y + (planeHitX - x) * (dirY / dirX);
+        offset = planeHitY - cellY;
+        if ((planeHitX - x) * dirX < 0) {
+            return FALSE;
+        }
+    } else {
+        if (dirY == 0) {
+            return FALSE;
+        }
+        planeHitY = cellY + TILE_SIZE / 2;
+        planeHitX = x + (planeHitY - y) * (dirX / dirY);
+        offset = planeHitX - cellX;
+        if ((planeHitY - y) * dirY < 0) {
+            return FALSE;
+        }
+    }
+
+    // the panel slides away along its own axis, leaving the start of the cell open
+    if (offset < door->openAmount * TILE_SIZE || offset >= TILE_SIZE) {
+        return FALSE;
+    }
+    *hitX = planeHitX;
+    *hitY = planeHitY;
+    return TRUE;
+}
+
+int mapDoorTextureOffset(const struct Map *map, float x, float y) {
+    int col = floor(x / TILE_SIZE);
+    int row = floor(y / TILE_SIZE);
+    const struct Door *door = &map->doors[map->doorAt[row * map->numCols + col]];
+    float offset = door->isVertical ? y - row * TILE_SIZE : x - col * TILE_SIZE;
+    return (int) (offset - door->openAmount * TILE_SIZE);
+}
@@ -0,0 +1,65 @@
+#ifndef RAYCASTING_MAP_H
+#define RAYCASTING_MAP_H
+
+#include <stdint.h>
+
+#include "constants.h"
+
+#define DOOR_OPEN_SPEED 1.0f // fraction of a cell per second
+
+struct Door {
+    int col;
+    int row;
+    int isVertical;  // the panel runs along the y axis and slides along it
+    float openAmount; // 0 is closed, 1 is fully open
+    int direction; // +1 opening, -1 closing, 0 idle
+};
+
+struct Map {
+    int numCols;
+    int numRows;
+    int *cells;
+
+    // derived from the cells, kept up to date by setMapCell() and updateDoors()
+    uint32_t *occupancy; // one bit per solid cell
+    int revision; // bumped on every change that affects rendering
+
+    struct Door doors[MAX_DOORS];
+    int numDoors;
+    int *doorAt; // door of every cell, -1 when there is none
+};
+
+// the stock map
+extern const int defaultMap[MAP_NUM_ROWS][MAP_NUM_COLS];
+
+// copies the cells, registers the doors and builds the derived structures
+int initMap(struct Map *map, const int *cells, int numCols, int numRows);
+
+void freeMap(struct Map *map);
+
+int mapHasWallAt(const struct Map *map, float x, float y);
+
+int mapIsSolidCell(const struct Map *map, int col, int row);
+
+// content of a cell, cells outside of the map read as plain walls
+int mapContentAt(const struct Map *map, int col, int row);
+
+// Runtime edit of a single cell, only the derived data of that cell is updated.
+void setMapCell(struct Map *map, int col, int row, int content);
+
+int findDoor(const struct Map *map, int col, int row);
+
+void toggleDoor(struct Map *map, int index);
+
+// Animates the doors, returns TRUE when any of them moved.
+int updateDoors(struct Map *map, float deltaTime);
+
+// Tests the ray entering door cell (col, row) at (x, y) against the door panel.
+// On a hit, stores the hit point and returns TRUE.
+int mapDoorHit(const struct Map *map, int col, int row, float x, float y, float dirX, float dirY,
+               float *hitX, float *hitY);
+
+// texture offset along the panel of a door hit at (x, y)
+int mapDoorTextureOffset(const struct Map *map, float x, float y);
+
+#endif //RAYCASTING_MAP_H
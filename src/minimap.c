@@ -0,0 +1,168 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minimap.h"
+
+#define MINI_MAP_RAY_COLOR 0x007F0000 // half of pure red, added over the halved background
+#define MINI_MAP_CAMERA_COLOR 0xFFFFFF00
+#define MINI_MAP_CAMERA_SIZE 8
+
+static void fillRect(uint32_t *pixels, int width, int height, int x, int y, int w, int h, uint32_t color) {
+    int lastX = x + w > width ? width : x + w;
+    int lastY = y + h > height ? height : y + h;
+    for (int row = y < 0 ? 0 : y; row < lastY; ++row) {
+        for (int col = x < 0 ? 0 : x; col < lastX; ++col) {
+            pixels[width * row + col] = color;
+        }
+    }
+}
+
+// Sets up the scale and rasterizes the tiles again when the map changed.
+static int updateTileLayer(struct Raycaster *rc) {
+    const struct Map *map = &rc->world->map;
+    int mapSize = map->numCols > map->numRows ? map->numCols * TILE_SIZE : map->numRows * TILE_SIZE;
+    // no larger than MAX_MINI_MAP_SIZE, nor than half of the view
+    int maxSize = rc->width / 2 < rc->height / 2 ? rc->width / 2 : rc->height / 2;
+    maxSize = maxSize > MAX_MINI_MAP_SIZE ? MAX_MINI_MAP_SIZE : maxSize;
+    float scale = mapSize * MINI_MAP_SCALE_FACTOR > maxSize ? (float) maxSize / mapSize : MINI_MAP_SCALE_FACTOR;
+    int miniMapWidth = map->numCols * TILE_SIZE * scale;
+    int miniMapHeight = map->numRows * TILE_SIZE * scale;
+
+    if (rc->miniMapTiles && rc->miniMapRevision == map->revision && rc->miniMapWidth == miniMapWidth &&
+        rc->miniMapHeight == miniMapHeight) {
+        return TRUE;
+    }
+    if (!rc->miniMapTiles || rc->miniMapWidth * rc->miniMapHeight < miniMapWidth * miniMapHeight) {
+        free(rc->miniMapTiles);
+        rc->miniMapTiles = malloc(sizeof(uint32_t) * miniMapWidth * miniMapHeight);
+        if (!rc->miniMapTiles) {
+            return FALSE;
+        }
+    }
+    rc->miniMapScale = scale;
+    rc->miniMapWidth = miniMapWidth;
+    rc->miniMapHeight = miniMapHeight;
+    rc->miniMapRevision = map->revision;
+
+    fillRect(rc->miniMapTiles, miniMapWidth, miniMapHeight, 0, 0, miniMapWidth, miniMapHeight, 0xFF000000);
+    for (int row = 0; row < map->numRows; ++row) {
+        for (int col = 0; col < map->numCols; ++col) {
+            if (map->cells[map->numCols * row + col] != 0) {
+                int x = col * TILE_SIZE * scale;
+                int y = row * TILE_SIZE * scale;
+                int w = (int) ((col + 1) * TILE_SIZE * scale) - x;
+                int h = (int) ((row + 1) * TILE_SIZE * scale) - y;
+                fillRect(rc->miniMapTiles, miniMapWidth, miniMapHeight, x, y, w, h, 0xFFFFFFFF);
+            }
+        }
+    }
+    return TRUE;
+}
+
+// Even-odd scanline fill of a polygon, blending the ray color over every covered pixel once.
+static void fillPolygon(struct Raycaster *rc, const float *xs, const float *ys, int numVertices) {
+    float crossings[MAX_MINI_MAP_RAYS + 2];
+    float minY = ys[0], maxY = ys[0];
+    for (int i = 1; i < numVertices; ++i) {
+        minY = ys[i] < minY ? ys[i] : minY;
+        maxY = ys[i] > maxY ? ys[i] : maxY;
+    }
+    int firstRow = minY < 0 ? 0 : (int) ceil(minY - 0.5f);
+    int lastRow = maxY > rc->miniMapHeight ? rc->miniMapHeight : (int) ceil(maxY - 0.5f);
+
+    for (int row = firstRow; row < lastRow; ++row) {
+        // sample at the pixel centers
+        float y = row + 0.5f;
+        int numCrossings = 0;
+        for (int i = 0, j = numVertices - 1; i < numVertices; j = i++) {
+            if ((ys[i] <= y) != (ys[j] <= y)) {
+                crossings[numCrossings++] = xs[j] + (y - ys[j]) / (ys[i] - ys[j]) * (xs[i] - xs[j]);
+            }
+        }
+        // insertion sort, there are only a few crossings per row
+        for (int i = 1; i < numCrossings; ++i) {
+            float crossing = crossings[i];
+            int k = i - 1;
+            for (; k >= 0 && crossings[k] > crossing; --k) {
+                crossings[k + 1] = crossings[k];
+            }
+            crossings[k + 1] = crossing;
+        }
+        uint32_t *pixels = rc->colorBuffer + rc->width * row;
+        for (int i = 0; i + 1 < numCrossings; i += 2) {
+            int firstX = (int) ceil(crossings[i] - 0.5f);
+            int lastX = (int) ceil(crossings[i + 1] - 0.5f);
+            firstX = firstX < 0 ? 0 : firstX;
+            lastX = lastX > rc->miniMapWidth ? rc->miniMapWidth : lastX;
+            for (int x = firstX; x < lastX; ++x) {
+                pixels[x] = 0xFF000000 | (((pixels[x] & 0x00FEFEFE) >> 1) + MINI_MAP_RAY_COLOR);
+            }
+        }
+    }
+}
+
+// Bresenham line, clipped to the minimap
+static void drawLine(struct Raycaster *rc, int x0, int y0, int x1, int y1, uint32_t color) {
+    int dx = abs(x1 - x0);
+    int dy = -abs(y1 - y0);
+    int stepX = x0 < x1 ? 1 : -1;
+    int stepY = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    for (;;) {
+        if (x0 >= 0 && x0 < rc->miniMapWidth && y0 >= 0 && y0 < rc->miniMapHeight) {
+            rc->colorBuffer[rc->width * y0 + x0] = color;
+        }
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int doubleError = 2 * error;
+        if (doubleError >= dy) {
+            error += dy;
+            x0 += stepX;
+        }
+        if (doubleError <= dx) {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+void drawMiniMap(struct Raycaster *rc) {
+    if (!updateTileLayer(rc)) {
+        return;
+    }
+    float scale = rc->miniMapScale;
+    for (int row = 0; row < rc->miniMapHeight; ++row) {
+        memcpy(rc->colorBuffer + rc->width * row, rc->miniMapTiles + rc->miniMapWidth * row,
+               sizeof(uint32_t) * rc->miniMapWidth);
+    }
+
+    // the visibility polygon: the camera and the hits of a subset of the rays, in angle order
+    float xs[MAX_MINI_MAP_RAYS + 2];
+    float ys[MAX_MINI_MAP_RAYS + 2];
+    int rayStep = (rc->width + MAX_MINI_MAP_RAYS - 1) / MAX_MINI_MAP_RAYS;
+    xs[0] = rc->camera.x * scale;
+    ys[0] = rc->camera.y * scale;
+    int numVertices = 1;
+    for (int i = 0; i < rc->width; i += rayStep) {
+        int ray = i + rayStep >= rc->width ? rc->width - 1 : i;
+        xs[numVertices] = rc->rays[ray].wallHitX * scale;
+        ys[numVertices] = rc->rays[ray].wallHitY * scale;
+        numVertices++;
+    }
+    fillPolygon(rc, xs, ys, numVertices);
+
+    int cameraX = rc->camera.x * scale;
+    int cameraY = rc->camera.y * scale;
+    int cameraSize = MINI_MAP_CAMERA_SIZE * scale < 1 ? 1 : MINI_MAP_CAMERA_SIZE * scale;
+    for (int y = cameraY - cameraSize / 2; y < cameraY - cameraSize / 2 + cameraSize; ++y) {
+        for (int x = cameraX - cameraSize / 2; x < cameraX - cameraSize / 2 + cameraSize; ++x) {
+            if (x >= 0 && x < rc->miniMapWidth && y >= 0 && y < rc->miniMapHeight) {
+                rc->colorBuffer[rc->width * y + x] = MINI_MAP_CAMERA_COLOR;
+            }
+        }
+    }
+    drawLine(rc, cameraX, cameraY, cameraX + cos(rc->camera.angle) * 40, cameraY + sin(rc->camera.angle) * 40,
+             MINI_MAP_CAMERA_COLOR);
+}
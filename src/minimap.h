@@ -0,0 +1,11 @@
+#ifndef RAYCASTING_MINIMAP_H
+#define RAYCASTING_MINIMAP_H
+
+#include "raycaster.h"
+
+// Software minimap composited into the top left corner of the color buffer of a view: the tiles,
+// the fan of the rays of the last cast and the camera. Works headless and for every view, so
+// the whole frame goes out in one upload. The tile layer is rasterized once per map revision.
+void drawMiniMap(struct Raycaster *rc);
+
+#endif //RAYCASTING_MINIMAP_H
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+
+#include "multiview.h"
+#include "profiler.h"
+
+// columns per job; a multiple of 16 keeps the tiles of neighbouring threads off the same cache lines
+#define VIEW_TILE_WIDTH 64
+
+struct MultiViewJob {
+    struct Raycaster **views;
+    int numViews;
+    int *firstTiles; // index of the first job of every view, numViews + 1 entries
+    int *numPendingTiles; // tiles of every view still to cast and project
+};
+
+// finds the view a job belongs to and the columns of its tile, returns the index of the view
+static int jobTile(const struct MultiViewJob *batch, int jobIndex, int *firstColumn, int *lastColumn) {
+    int low = 0;
+    int high = batch->numViews - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (batch->firstTiles[middle] <= jobIndex) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    struct Raycaster *rc = batch->views[low];
+    *firstColumn = (jobIndex - batch->firstTiles[low]) * VIEW_TILE_WIDTH;
+    *lastColumn = *firstColumn + VIEW_TILE_WIDTH > rc->width ? rc->width : *firstColumn + VIEW_TILE_WIDTH;
+    return low;
+}
+
+static void castAndProjectTile(void *context, int jobIndex) {
+    struct MultiViewJob *batch = context;
+    int firstColumn, lastColumn;
+    int view = jobTile(batch, jobIndex, &firstColumn, &lastColumn);
+    struct Raycaster *rc = batch->views[view];
+    renderColumns(rc, firstColumn, lastColumn);
+
+    // the last tile of a view has all its rays, the thread that cast it culls the sprites of the view;
+    // every view has its own query scratch, so views cull in parallel with the tiles of the others
+    if (__sync_sub_and_fetch(&batch->numPendingTiles[view], 1) == 0 && renderModeHasSprites(rc->renderMode)) {
+        uint64_t start = profileBegin();
+        int numCandidates = findVisibleSprites(rc);
+        prepareSprites(rc, rc->visibleSpriteIds, numCandidates);
+        profileEnd(PROFILE_SPRITES, start);
+    }
+}
+
+static void drawSpritesTile(void *context, int jobIndex) {
+    struct MultiViewJob *batch = context;
+    int firstColumn, lastColumn;
+    struct Raycaster *rc = batch->views[jobTile(batch, jobIndex, &firstColumn, &lastColumn)];
+    if (renderModeHasSprites(rc->renderMode)) {
+        uint64_t start = profileBegin();
+        drawSprites(rc, firstColumn, lastColumn);
+        profileEnd(PROFILE_SPRITES, start);
+    }
+}
+
+void renderViews(struct ThreadPool *pool, struct Raycaster **views, int numViews) {
+    if (numViews <= 0) {
+        return;
+    }
+    // no heap allocation per frame, the tile tables live in the scratch arena of this thread
+    struct Arena *scratch = threadArena();
+    size_t scratchMark = scratch ? arenaMark(scratch) : 0;
+    int *firstTiles = scratch ? arenaAlloc(scratch, sizeof(int) * (numViews + 1)) : NULL;
+    int *numPendingTiles = firstTiles ? arenaAlloc(scratch, sizeof(int) * numViews) : NULL;
+    if (!numPendingTiles) {
+        if (scratch) {
+            arenaRelease(scratch, scratchMark);
+        }
+        // still render, one view at a time
+        for (int i = 0; i < numViews; ++i) {
+            renderFrame(views[i]);
+        }
+        return;
+    }
+    firstTiles[0] = 0;
+    for (int i = 0; i < numViews; ++i) {
+        firstTiles[i + 1] = firstTiles[i] + (views[i]->width + VIEW_TILE_WIDTH - 1) / VIEW_TILE_WIDTH;
+        numPendingTiles[i] = firstTiles[i + 1] - firstTiles[i];
+    }
+    struct MultiViewJob batch = {views, numViews, firstTiles, numPendingTiles};
+    for (int i = 0; i < numViews; ++i) {
+        beginFrame(views[i]);
+    }
+
+    threadPoolRun(pool, castAndProjectTile, &batch, firstTiles[numViews]);
+    threadPoolRun(pool, drawSpritesTile, &batch, firstTiles[numViews]);
+    arenaRelease(scratch, scratchMark);
+}
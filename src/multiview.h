@@ -0,0 +1,13 @@
+#ifndef RAYCASTING_MULTIVIEW_H
+#define RAYCASTING_MULTIVIEW_H
+
+#include "raycaster.h"
+#include "threadpool.h"
+
+// Renders a frame for every view in a single call, each in its own render mode.
+// The views are cut in column tiles and all the (view, tile) jobs share the pool, so
+// the threads stay busy even when there are fewer views than threads or the views are small.
+// Views of the same world must not be rendered while the world is being updated.
+void renderViews(struct ThreadPool *pool, struct Raycaster **views, int numViews);
+
+#endif //RAYCASTING_MULTIVIEW_H
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAS_AVX2_PATH 1
+#endif
+
+#include "palette.h"
+
+// the histogram keeps 5 bits per channel
+#define HISTOGRAM_BITS 5
+#define HISTOGRAM_SIZE (1 << (3 * HISTOGRAM_BITS))
+
+struct ColorBin {
+    uint8_t channels[3]; // red, green, blue of the bin, from its average color
+    uint32_t weight;
+    uint32_t sums[3];
+};
+
+struct ColorBox {
+    int first;
+    int count;
+    uint32_t weight;
+    int longestChannel;
+    int range;
+};
+
+static uint32_t dimColor(uint32_t color, int lightLevel) {
+    uint32_t red = ((color >> 16) & 0xFF) * (lightLevel + 1) / NUM_LIGHT_LEVELS;
+    uint32_t green = ((color >> 8) & 0xFF) * (lightLevel + 1) / NUM_LIGHT_LEVELS;
+    uint32_t blue = (color & 0xFF) * (lightLevel + 1) / NUM_LIGHT_LEVELS;
+    return 0xFF000000 | (red << 16) | (green << 8) | blue;
+}
+
+static int compareRed(const void *a, const void *b) {
+    return ((const struct ColorBin *) a)->channels[0] - ((const struct ColorBin *) b)->channels[0];
+}
+
+static int compareGreen(const void *a, const void *b) {
+    return ((const struct ColorBin *) a)->channels[1] - ((const struct ColorBin *) b)->channels[1];
+}
+
+static int compareBlue(const void *a, const void *b) {
+    return ((const struct ColorBin *) a)->channels[2] - ((const struct ColorBin *) b)->channels[2];
+}
+
+static void measureBox(const struct ColorBin *bins, struct ColorBox *box) {
+    int low[3] = {255, 255, 255};
+    int high[3] = {0, 0, 0};
+    box->weight = 0;
+    for (int i = box->first; i < box->first + box->count; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            low[c] = bins[i].channels[c] < low[c] ? bins[i].channels[c] : low[c];
+            high[c] = bins[i].channels[c] > high[c] ? bins[i].channels[c] : high[c];
+        }
+        box->weight += bins[i].weight;
+    }
+    box->longestChannel = 0;
+    for (int c = 1; c < 3; ++c) {
+        if (high[c] - low[c] > high[box->longestChannel] - low[box->longestChannel]) {
+            box->longestChannel = c;
+        }
+    }
+    box->range = high[box->longestChannel] - low[box->longestChannel];
+}
+
+static uint32_t boxColor(const struct ColorBin *bins, const struct ColorBox *box) {
+    uint64_t sums[3] = {0, 0, 0};
+    uint64_t weight = 0;
+    for (int i = box->first; i < box->first + box->count; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            sums[c] += bins[i].sums[c];
+        }
+        weight += bins[i].weight;
+    }
+    return 0xFF000000 | (uint32_t) (sums[0] / weight) << 16 | (uint32_t) (sums[1] / weight) << 8 |
+           (uint32_t) (sums[2] / weight);
+}
+
+// Splits boxes until the palette is full, always the one with the most weight times color range.
+static int medianCut(struct ColorBin *bins, int numBins, struct ColorBox *boxes, int maxBoxes) {
+    static int (*const comparators[3])(const void *, const void *) = {compareRed, compareGreen, compareBlue};
+    boxes[0].first = 0;
+    boxes[0].count = numBins;
+    measureBox(bins, &boxes[0]);
+    int numBoxes = 1;
+
+    while (numBoxes < maxBoxes) {
+        int best = -1;
+        uint64_t bestScore = 0;
+        for (int i = 0; i < numBoxes; ++i) {
+            uint64_t score = (uint64_t) boxes[i].weight * boxes[i].range;
+            if (boxes[i].count > 1 && score > bestScore) {
+                best = i;
+                bestScore = score;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        struct ColorBox *box = &boxes[best];
+        qsort(bins + box->first, box->count, sizeof(struct ColorBin), comparators[box->longestChannel]);
+
+        // split at the weighted median, keeping a bin on each side
+        uint32_t half = box->weight / 2;
+        uint32_t accumulated = 0;
+        int split = 1;
+        for (int i = 0; i < box->count - 1; ++i) {
+            accumulated += bins[box->first + i].weight;
+            split = i + 1;
+            if (accumulated >= half) {
+                break;
+            }
+        }
+        struct ColorBox *upper = &boxes[numBoxes++];
+        upper->first = box->first + split;
+        upper->count = box->count - split;
+        box->count = split;
+        measureBox(bins, box);
+        measureBox(bins, upper);
+    }
+    return numBoxes;
+}
+
+void buildPalette(struct Palette *palette, const uint32_t *const *images, const int *imageSizes, int numImages) {
+    struct ColorBin *histogram = calloc(HISTOGRAM_SIZE, sizeof(struct ColorBin));
+    struct ColorBox *boxes = malloc(sizeof(struct ColorBox) * PALETTE_SIZE);
+    for (int i = 0; i < PALETTE_SIZE; ++i) {
+        palette->colors[i] = 0xFF000000;
+    }
+    if (!histogram || !boxes) {
+        free(histogram);
+        free(boxes);
+        memset(palette->colormap, 0, sizeof(palette->colormap));
+        return;
+    }
+
+    for (int image = 0; image < numImages; ++image) {
+        for (int t = 0; t < imageSizes[image]; ++t) {
+            uint32_t texel = images[image][t];
+            if (!(texel & 0xFF000000)) {
+                continue;
+            }
+            for (int level = 0; level < NUM_LIGHT_LEVELS; ++level) {
+                uint32_t color = dimColor(texel, level);
+                int shift = 8 - HISTOGRAM_BITS;
+                int bin = (((color >> 16) & 0xFF) >> shift) << (2 * HISTOGRAM_BITS) |
+                          (((color >> 8) & 0xFF) >> shift) << HISTOGRAM_BITS | ((color & 0xFF) >> shift);
+                histogram[bin].weight++;
+                histogram[bin].sums[0] += (color >> 16) & 0xFF;
+                histogram[bin].sums[1] += (color >> 8) & 0xFF;
+                histogram[bin].sums[2] += color & 0xFF;
+            }
+        }
+    }
+
+    // pack the used bins at the front
+    int numBins = 0;
+    for (int i = 0; i < HISTOGRAM_SIZE; ++i) {
+        if (histogram[i].weight) {
+            struct ColorBin *bin = &histogram[numBins++];
+            *bin = histogram[i];
+            for (int c = 0; c < 3; ++c) {
+                bin->channels[c] = bin->sums[c] / bin->weight;
+            }
+        }
+    }
+
+    if (numBins > 0) {
+        int numBoxes = medianCut(histogram, numBins, boxes, PALETTE_SIZE - 1);
+        for (int i = 0; i < numBoxes; ++i) {
+            palette->colors[i + 1] = boxColor(histogram, &boxes[i]);
+        }
+    }
+    free(histogram);
+    free(boxes);
+
+    for (int level = 0; level < NUM_LIGHT_LEVELS; ++level) {
+        palette->colormap[level][TRANSPARENT_INDEX] = TRANSPARENT_INDEX;
+        for (int i = 1; i < PALETTE_SIZE; ++i) {
+            palette->colormap[level][i] = paletteNearest(palette, dimColor(palette->colors[i], level));
+        }
+    }
+}
+
+uint8_t paletteNearest(const struct Palette *palette, uint32_t color) {
+    int red = (color >> 16) & 0xFF;
+    int green = (color >> 8) & 0xFF;
+    int blue = color & 0xFF;
+    int best = 1;
+    int bestDistance = 0x7FFFFFFF;
+    for (int i = 1; i < PALETTE_SIZE; ++i) {
+        int dr = red - (int) ((palette->colors[i] >> 16) & 0xFF);
+        int dg = green - (int) ((palette->colors[i] >> 8) & 0xFF);
+        int db = blue - (int) (palette->colors[i] & 0xFF);
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance) {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+void quantizeImage(const struct Palette *palette, const uint32_t *image, uint8_t *indices, int size) {
+    for (int i = 0; i < size; ++i) {
+        indices[i] = image[i] & 0xFF000000 ? paletteNearest(palette, image[i]) : TRANSPARENT_INDEX;
+    }
+}
+
+#ifdef HAS_AVX2_PATH
+__attribute__((target("avx2")))
+static int expandPaletteAvx2(const struct Palette *palette, const uint8_t *indices, uint32_t *out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (indices + i)));
+        __m256i colors = _mm256_i32gather_epi32((const int *) palette->colors, lanes, 4);
+        _mm256_storeu_si256((__m256i *) (out + i), colors);
+    }
+    return i;
+}
+#endif
+
+void expandPalette(const struct Palette *palette, const uint8_t *indices, uint32_t *out, int count) {
+    int i = 0;
+#ifdef HAS_AVX2_PATH
+    static int hasAvx2 = -1;
+    if (hasAvx2 < 0) {
+        hasAvx2 = __builtin_cpu_supports("avx2");
+    }
+    if (hasAvx2) {
+        i = expandPaletteAvx2(palette, indices, out, count);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = palette->colors[indices[i]];
+    }
+}
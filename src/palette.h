@@ -0,0 +1,31 @@
+#ifndef RAYCASTING_PALETTE_H
+#define RAYCASTING_PALETTE_H
+
+#include <stdint.h>
+
+#include "constants.h"
+
+// index 0 is kept for transparent sprite texels and is never picked for a color
+#define TRANSPARENT_INDEX 0
+#define PALETTE_SIZE 256
+
+// 8-bit color: 256 ARGB entries and a colormap giving, for every light level, the entry
+// closest to every entry dimmed to that level. Light level NUM_LIGHT_LEVELS - 1 is full bright.
+struct Palette {
+    uint32_t colors[PALETTE_SIZE];
+    uint8_t colormap[NUM_LIGHT_LEVELS][PALETTE_SIZE];
+};
+
+// Median cut over the given colors at every light level, so the dimmed colors stay close to
+// an entry too. Colors with zero alpha are skipped.
+void buildPalette(struct Palette *palette, const uint32_t *const *images, const int *imageSizes, int numImages);
+
+uint8_t paletteNearest(const struct Palette *palette, uint32_t color);
+
+// Converts ARGB texels to palette indices, zero alpha texels become TRANSPARENT_INDEX.
+void quantizeImage(const struct Palette *palette, const uint32_t *image, uint8_t *indices, int size);
+
+// Palette lookup of count indices into ARGB8888, with AVX2 gathers where the CPU has them.
+void expandPalette(const struct Palette *palette, const uint8_t *indices, uint32_t *out, int count);
+
+#endif //RAYCASTING_PALETTE_H
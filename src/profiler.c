@@ -0,0 +1,194 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "constants.h"
+#include "profiler.h"
+
+struct ProfileEvent {
+    int stage;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct ProfileRing {
+    int threadId;
+    int next;  // slot of the next event
+    int count;
+    struct ProfileEvent events[PROFILE_RING_SIZE];
+};
+
+static const char *stageNames[NUM_PROFILE_STAGES] = {
+        "frame", "input", "move", "world", "cast", "projection", "sprites", "color buffer", "clear", "minimap", "hud",
+        "latency"
+};
+
+static const char *arenaNames[NUM_PROFILE_ARENAS] = {"frame arena", "thread arena"};
+
+static int profilerEnabled = FALSE;
+static uint64_t traceStart;
+
+static struct ProfileRing rings[MAX_PROFILE_THREADS];
+static int numRings;
+static __thread struct ProfileRing *threadRing;
+
+// time of every stage in the current frame, added from any thread
+static uint64_t frameTotals[NUM_PROFILE_STAGES];
+static uint64_t history[PROFILE_HISTORY][NUM_PROFILE_STAGES];
+static int historyNext;
+static int historyCount;
+
+static size_t arenaHighWaters[NUM_PROFILE_ARENAS];
+static size_t arenaSizes[NUM_PROFILE_ARENAS];
+
+void profilerEnable(int isEnabled) {
+    if (isEnabled && !profilerEnabled) {
+        traceStart = profileNow();
+        for (int kind = 0; kind < NUM_PROFILE_ARENAS; ++kind) {
+            arenaHighWaters[kind] = 0;
+        }
+    }
+    profilerEnabled = isEnabled;
+}
+
+int profilerIsEnabled(void) {
+    return profilerEnabled;
+}
+
+uint64_t profileNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+uint64_t profileBegin(void) {
+    return profilerEnabled ? profileNow() : 0;
+}
+
+static struct ProfileRing *currentRing(void) {
+    if (!threadRing) {
+        int index = __sync_fetch_and_add(&numRings, 1);
+        if (index >= MAX_PROFILE_THREADS) {
+            return NULL;
+        }
+        threadRing = &rings[index];
+        threadRing->threadId = index;
+    }
+    return threadRing;
+}
+
+void profileEnd(int stage, uint64_t start) {
+    if (!profilerEnabled || !start) {
+        return;
+    }
+    uint64_t end = profileNow();
+    __sync_fetch_and_add(&frameTotals[stage], end - start);
+
+    struct ProfileRing *ring = currentRing();
+    if (!ring) {
+        return;
+    }
+    struct ProfileEvent *event = &ring->events[ring->next];
+    event->stage = stage;
+    event->start = start;
+    event->end = end;
+    ring->next = (ring->next + 1) % PROFILE_RING_SIZE;
+    if (ring->count < PROFILE_RING_SIZE) {
+        ring->count++;
+    }
+}
+
+void profileFrameEnd(void) {
+    if (!profilerEnabled) {
+        return;
+    }
+    // swapped atomically, the pipelined loop still renders the next frame meanwhile
+    for (int stage = 0; stage < NUM_PROFILE_STAGES; ++stage) {
+        history[historyNext][stage] = __sync_lock_test_and_set(&frameTotals[stage], 0);
+    }
+    historyNext = (historyNext + 1) % PROFILE_HISTORY;
+    if (historyCount < PROFILE_HISTORY) {
+        historyCount++;
+    }
+}
+
+const char *profileStageName(int stage) {
+    return stageNames[stage];
+}
+
+float profileAverageMs(int stage) {
+    if (historyCount == 0) {
+        return 0;
+    }
+    uint64_t sum = 0;
+    int count = 0;
+    for (int i = 0; i < historyCount; ++i) {
+        sum += history[i][stage];
+        count += stage != PROFILE_LATENCY || history[i][stage];
+    }
+    return count ? (float) sum / count / 1e6f : 0;
+}
+
+int profileFrameTimes(float *frameTimesMs, int maxFrames) {
+    int count = historyCount < maxFrames ? historyCount : maxFrames;
+    for (int i = 0; i < count; ++i) {
+        int frame = (historyNext - count + i + PROFILE_HISTORY) % PROFILE_HISTORY;
+        frameTimesMs[i] = history[frame][PROFILE_FRAME] / 1e6f;
+    }
+    return count;
+}
+
+void profileArenaUsage(int kind, size_t highWater, size_t size) {
+    if (!profilerEnabled) {
+        return;
+    }
+    // arenas of several threads report at once
+    size_t current = arenaHighWaters[kind];
+    while (highWater > current) {
+        size_t seen = __sync_val_compare_and_swap(&arenaHighWaters[kind], current, highWater);
+        if (seen == current) {
+            break;
+        }
+        current = seen;
+    }
+    arenaSizes[kind] = size;
+}
+
+const char *profileArenaName(int kind) {
+    return arenaNames[kind];
+}
+
+size_t profileArenaHighWater(int kind, size_t *size) {
+    if (size) {
+        *size = arenaSizes[kind];
+    }
+    return arenaHighWaters[kind];
+}
+
+int profileWriteChromeTrace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        return FALSE;
+    }
+    fprintf(file, "{\"traceEvents\":[");
+    int isFirst = TRUE;
+    int ringCount = numRings < MAX_PROFILE_THREADS ? numRings : MAX_PROFILE_THREADS;
+    for (int r = 0; r < ringCount; ++r) {
+        const struct ProfileRing *ring = &rings[r];
+        for (int i = 0; i < ring->count; ++i) {
+            const struct ProfileEvent *event = &ring->events[(ring->next - ring->count + i + PROFILE_RING_SIZE) %
+                                                             PROFILE_RING_SIZE];
+            if (event->start < traceStart) {
+                continue;
+            }
+            // complete events, timestamps in microseconds
+            fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    isFirst ? "" : ",", stageNames[event->stage], ring->threadId,
+                    (event->start - traceStart) / 1e3, (event->end - event->start) / 1e3);
+            isFirst = FALSE;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,68 @@
+#ifndef RAYCASTING_PROFILER_H
+#define RAYCASTING_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// stages of a frame, timed with profileBegin()/profileEnd()
+#define PROFILE_FRAME 0
+#define PROFILE_INPUT 1
+#define PROFILE_MOVE 2
+#define PROFILE_WORLD 3
+#define PROFILE_CAST 4
+#define PROFILE_PROJECTION 5
+#define PROFILE_SPRITES 6
+#define PROFILE_COLOR_BUFFER 7
+#define PROFILE_CLEAR 8
+#define PROFILE_MINIMAP 9
+#define PROFILE_HUD 10
+#define PROFILE_LATENCY 11 // from an input event to the present of the first frame showing it
+#define NUM_PROFILE_STAGES 12
+
+// arenas, see arena.h
+#define PROFILE_ARENA_FRAME 0
+#define PROFILE_ARENA_THREAD 1
+#define NUM_PROFILE_ARENAS 2
+
+#define PROFILE_HISTORY 120 // frames kept for the rolling averages and the graph
+#define PROFILE_RING_SIZE 4096 // events kept per thread for the trace
+#define MAX_PROFILE_THREADS 64
+
+// Lightweight scoped timers. Every thread records its events in its own ring buffer, without
+// locks; stages timed on several threads at once (the column tiles) add up their CPU time.
+// Disabled by default, profileBegin() then returns 0 and profileEnd() does nothing.
+void profilerEnable(int isEnabled);
+
+int profilerIsEnabled(void);
+
+// monotonic time in nanoseconds
+uint64_t profileNow(void);
+
+uint64_t profileBegin(void);
+
+void profileEnd(int stage, uint64_t start);
+
+// Closes the frame: its stage totals go into the history. Call once per frame, between frames.
+void profileFrameEnd(void);
+
+const char *profileStageName(int stage);
+
+// average time of a stage per frame over the history, in milliseconds; the latency is averaged
+// over the frames that had some input only
+float profileAverageMs(int stage);
+
+// Writes the frame times of the history, oldest first, and returns their count.
+int profileFrameTimes(float *frameTimesMs, int maxFrames);
+
+// Keeps the largest high-water mark reported by the arenas of a kind, and their size.
+void profileArenaUsage(int kind, size_t highWater, size_t size);
+
+const char *profileArenaName(int kind);
+
+// largest high-water mark of the arenas of a kind since the profiler was enabled, in bytes
+size_t profileArenaHighWater(int kind, size_t *size);
+
+// Dumps the events of every ring in Chrome trace event JSON, for chrome://tracing or Perfetto.
+int profileWriteChromeTrace(const char *path);
+
+#endif //RAYCASTING_PROFILER_H
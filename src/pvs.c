@@ -0,0 +1,585 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "profiler.h"
+#include "pvs.h"
+
+// Visibility is sampled from a grid of points inside every cell, in many directions, against the walls
+// eroded by PVS_WALL_INSET: a sightline of the real map passes within PVS_SAMPLE_REACH of a sample
+// point and within PVS_WALL_INSET of a traced ray, which the eroded walls never stop before its end.
+#define PVS_SAMPLES_PER_AXIS 6
+#define PVS_NUM_SAMPLES (PVS_SAMPLES_PER_AXIS * PVS_SAMPLES_PER_AXIS)
+#define PVS_SAMPLE_REACH (TILE_SIZE / (PVS_SAMPLES_PER_AXIS * 1.41421356)) // farthest a point is from a sample
+#define PVS_WALL_INSET (TILE_SIZE / 4)
+// cells closer than this to a traced ray are visible: the end of a sightline, and the sprites around it
+#define PVS_MARGIN (PVS_WALL_INSET + SPRITE_REACH)
+
+static const char PVS_MAGIC[4] = {'P', 'V', 'S', '2'};
+
+uint32_t pvsMapChecksum(const int *mapCells, int numCols, int numRows) {
+    // FNV-1a over the cell contents
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < numCols * numRows; ++i) {
+        hash = (hash ^ (uint32_t) mapCells[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int isOccluder(int content) {
+    return content != 0 && content != DOOR_CELL;
+}
+
+// the map is surrounded by walls
+static int isOccluderAt(const int *mapCells, int numCols, int numRows, int col, int row) {
+    return col < 0 || col >= numCols || row < 0 || row >= numRows || isOccluder(mapCells[row * numCols + col]);
+}
+
+// clips [*enter, *exit] of the ray to the slab low <= origin + t * dir <= high
+static int clipSlab(double origin, double dir, double low, double high, double *enter, double *exit) {
+    if (dir == 0) {
+        return origin >= low && origin <= high;
+    }
+    double t0 = (low - origin) / dir;
+    double t1 = (high - origin) / dir;
+    if (t0 > t1) {
+        double swap = t0;
+        t0 = t1;
+        t1 = swap;
+    }
+    *enter = t0 > *enter ? t0 : *enter;
+    *exit = t1 < *exit ? t1 : *exit;
+    return *enter <= *exit;
+}
+
+// Where the ray enters the eroded wall of cell between tIn and tOut, INFINITY when it does not.
+// The wall is inset by PVS_WALL_INSET on the sides facing an open cell, and loses a square of that
+// size at the corners facing an open diagonal cell between two walls: the erosion of all the walls.
+static double erodedWallEntry(const int *mapCells, int numCols, int numRows, int col, int row, double x, double y,
+                              double dirX, double dirY, double tIn, double tOut) {
+    double left = col * TILE_SIZE;
+    double top = row * TILE_SIZE;
+    double right = left + TILE_SIZE;
+    double bottom = top + TILE_SIZE;
+    int isLeftOpen = !isOccluderAt(mapCells, numCols, numRows, col - 1, row);
+    int isRightOpen = !isOccluderAt(mapCells, numCols, numRows, col + 1, row);
+    int isTopOpen = !isOccluderAt(mapCells, numCols, numRows, col, row - 1);
+    int isBottomOpen = !isOccluderAt(mapCells, numCols, numRows, col, row + 1);
+    double enter = tIn;
+    double exit = tOut;
+    if (!clipSlab(x, dirX, left + isLeftOpen * PVS_WALL_INSET, right - isRightOpen * PVS_WALL_INSET, &enter, &exit) ||
+        !clipSlab(y, dirY, top + isTopOpen * PVS_WALL_INSET, bottom - isBottomOpen * PVS_WALL_INSET, &enter, &exit)) {
+        return INFINITY;
+    }
+    for (int corner = 0; corner < 4; ++corner) {
+        int side = corner & 1 ? 1 : -1;
+        int vertical = corner & 2 ? 1 : -1;
+        if ((side < 0 ? isLeftOpen : isRightOpen) || (vertical < 0 ? isTopOpen : isBottomOpen) ||
+            isOccluderAt(mapCells, numCols, numRows, col + side, row + vertical)) {
+            continue;
+        }
+        // a corner square starting at the entry point moves the entry to where the ray leaves it
+        double cornerX = side < 0 ? left : right - PVS_WALL_INSET;
+        double cornerY = vertical < 0 ? top : bottom - PVS_WALL_INSET;
+        double squareEnter = enter;
+        double squareExit = exit;
+        if (clipSlab(x, dirX, cornerX, cornerX + PVS_WALL_INSET, &squareEnter, &squareExit) &&
+            clipSlab(y, dirY, cornerY, cornerY + PVS_WALL_INSET, &squareEnter, &squareExit) && squareEnter <= enter) {
+            enter = squareExit;
+        }
+    }
+    // grazing a face does not stop the ray
+    return enter < exit ? enter : INFINITY;
+}
+
+// grows the box of the traced rays inside cell, a cell of the map or of the ring of walls around it
+static void extendExtent(struct Pvs *pvs, int col, int row, double x0, double y0, double x1, double y1) {
+    double *extent = pvs->extents + 4 * ((row + 1) * (pvs->numCols + 2) + col + 1);
+    extent[0] = fmin(extent[0], fmin(x0, x1));
+    extent[1] = fmin(extent[1], fmin(y0, y1));
+    extent[2] = fmax(extent[2], fmax(x0, x1));
+    extent[3] = fmax(extent[3], fmax(y0, y1));
+}
+
+static void clearExtents(struct Pvs *pvs) {
+    for (int i = 0; i < (pvs->numCols + 2) * (pvs->numRows + 2); ++i) {
+        pvs->extents[4 * i] = pvs->extents[4 * i + 1] = INFINITY;
+        pvs->extents[4 * i + 2] = pvs->extents[4 * i + 3] = -INFINITY;
+    }
+}
+
+// marks the cells closer than PVS_MARGIN to the traced rays, along both axes, one box per cell
+static void markNearExtents(struct Pvs *pvs) {
+    int numCols = pvs->numCols;
+    int numRows = pvs->numRows;
+    for (int i = 0; i < (numCols + 2) * (numRows + 2); ++i) {
+        const double *extent = pvs->extents + 4 * i;
+        if (extent[0] > extent[2]) {
+            continue;
+        }
+        int firstCol = (int) floor((extent[0] - PVS_MARGIN) / TILE_SIZE);
+        int firstRow = (int) floor((extent[1] - PVS_MARGIN) / TILE_SIZE);
+        int lastCol = (int) floor((extent[2] + PVS_MARGIN) / TILE_SIZE);
+        int lastRow = (int) floor((extent[3] + PVS_MARGIN) / TILE_SIZE);
+        firstCol = firstCol < 0 ? 0 : firstCol;
+        firstRow = firstRow < 0 ? 0 : firstRow;
+        lastCol = lastCol >= numCols ? numCols - 1 : lastCol;
+        lastRow = lastRow >= numRows ? numRows - 1 : lastRow;
+        for (int row = firstRow; lastCol >= firstCol && row <= lastRow; ++row) {
+            memset(pvs->visible + row * numCols + firstCol, TRUE, lastCol - firstCol + 1);
+        }
+    }
+}
+
+static void traceRay(struct Pvs *pvs, const int *mapCells, double x, double y, double angle) {
+    int numCols = pvs->numCols;
+    int numRows = pvs->numRows;
+    double dirX = cos(angle);
+    double dirY = sin(angle);
+    int col = (int) floor(x / TILE_SIZE);
+    int row = (int) floor(y / TILE_SIZE);
+    int stepCol = dirX > 0 ? 1 : -1;
+    int stepRow = dirY > 0 ? 1 : -1;
+    double tDeltaX = dirX != 0 ? fabs(TILE_SIZE / dirX) : INFINITY;
+    double tDeltaY = dirY != 0 ? fabs(TILE_SIZE / dirY) : INFINITY;
+    double tMaxX = dirX != 0 ? ((col + (dirX > 0)) * TILE_SIZE - x) / dirX : INFINITY;
+    double tMaxY = dirY != 0 ? ((row + (dirY > 0)) * TILE_SIZE - y) / dirY : INFINITY;
+
+    // the walls around the map stop every ray in the ring of cells next to it
+    double tIn = 0;
+    while (col >= -1 && col <= numCols && row >= -1 && row <= numRows) {
+        double tOut = tMaxX < tMaxY ? tMaxX : tMaxY;
+        double tEnd = tOut;
+        if (isOccluderAt(mapCells, numCols, numRows, col, row)) {
+            double entry = erodedWallEntry(mapCells, numCols, numRows, col, row, x, y, dirX, dirY, tIn, tOut);
+            tEnd = entry < tOut ? entry : tOut;
+        }
+        extendExtent(pvs, col, row, x + dirX * tIn, y + dirY * tIn, x + dirX * tEnd, y + dirY * tEnd);
+        if (tEnd < tOut) {
+            return;
+        }
+        if (tMaxX < tMaxY) {
+            col += stepCol;
+            tMaxX += tDeltaX;
+        } else {
+            row += stepRow;
+            tMaxY += tDeltaY;
+        }
+        tIn = tOut;
+    }
+}
+
+static int writeVarint(uint8_t *out, uint32_t value) {
+    int size = 0;
+    while (value >= 0x80) {
+        out[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = (uint8_t) value;
+    return size;
+}
+
+static int readVarint(const uint8_t *in, int size, int *pos, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && *pos < size; shift += 7) {
+        uint8_t byte = in[(*pos)++];
+        result |= (uint32_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// encodes the visibility bitmap of a cell, scratch must hold 5 bytes per map cell plus one run;
+// the old set is kept when the new one cannot be allocated
+static int encodeCell(struct PvsCell *pvsCell, const uint8_t *visible, int numCells, uint8_t *scratch) {
+    int size = 0;
+    int state = FALSE;
+    int runStart = 0;
+    for (int i = 0; i <= numCells; ++i) {
+        int cellState = i < numCells ? visible[i] : !state;
+        if (cellState != state) {
+            size += writeVarint(scratch + size, (uint32_t) (i - runStart));
+            runStart = i;
+            state = cellState;
+        }
+    }
+
+    if (size > pvsCell->capacity) {
+        uint8_t *runs = malloc(size);
+        if (!runs) {
+            return FALSE;
+        }
+        free(pvsCell->runs);
+        pvsCell->runs = runs;
+        pvsCell->capacity = size;
+    }
+    memcpy(pvsCell->runs, scratch, size);
+    pvsCell->size = size;
+    return TRUE;
+}
+
+static void decodeCell(const struct PvsCell *pvsCell, uint8_t *visible, int numCells) {
+    memset(visible, 0, numCells);
+    int pos = 0;
+    int cellIndex = 0;
+    int isVisibleRun = FALSE;
+    uint32_t runLength;
+    while (readVarint(pvsCell->runs, pvsCell->size, &pos, &runLength) &&
+           runLength <= (uint32_t) (numCells - cellIndex)) {
+        if (isVisibleRun) {
+            memset(visible + cellIndex, TRUE, runLength);
+        }
+        cellIndex += (int) runLength;
+        isVisibleRun = !isVisibleRun;
+    }
+}
+
+// Marks the cells seen from a sample point of cell into pvs->visible. With a region, only the
+// rays crossing it are traced: the angles of the full set of rays between the ones to its corners.
+static void traceSample(struct Pvs *pvs, const int *mapCells, int cell, int sample, const struct PvsRebuild *region) {
+    int sx = sample % PVS_SAMPLES_PER_AXIS;
+    int sy = sample / PVS_SAMPLES_PER_AXIS;
+    // at the centers of a grid of squares over the cell, no point is farther than PVS_SAMPLE_REACH from one
+    double x = ((cell % pvs->numCols) + (sx + 0.5) / PVS_SAMPLES_PER_AXIS) * TILE_SIZE;
+    double y = ((cell / pvs->numCols) + (sy + 0.5) / PVS_SAMPLES_PER_AXIS) * TILE_SIZE;
+    int numAngles = pvs->numAngles;
+    double angleStep = TWO_PI / numAngles;
+
+    int first = 0;
+    int last = numAngles - 1;
+    if (region) {
+        double x0 = region->minCol * TILE_SIZE;
+        double y0 = region->minRow * TILE_SIZE;
+        double x1 = (region->maxCol + 1) * TILE_SIZE;
+        double y1 = (region->maxRow + 1) * TILE_SIZE;
+        if (x < x0 || x > x1 || y < y0 || y > y1) {
+            // outside the region, its corners span less than half a turn around the direction to its center
+            double center = atan2((y0 + y1) / 2 - y, (x0 + x1) / 2 - x);
+            double corners[4][2] = {{x0, y0}, {x1, y0}, {x0, y1}, {x1, y1}};
+            double low = 0;
+            double high = 0;
+            for (int i = 0; i < 4; ++i) {
+                double offset = atan2(corners[i][1] - y, corners[i][0] - x) - center;
+                offset = offset > PI ? offset - TWO_PI : (offset < -PI ? offset + TWO_PI : offset);
+                low = offset < low ? offset : low;
+                high = offset > high ? offset : high;
+            }
+            // one more ray on each side, for the rounding of the angles
+            int wedgeFirst = (int) floor((center + low) / angleStep) - 1;
+            int wedgeLast = (int) ceil((center + high) / angleStep) + 1;
+            if (wedgeLast - wedgeFirst + 1 < numAngles) {
+                first = wedgeFirst;
+                last = wedgeLast;
+            }
+        }
+    }
+    clearExtents(pvs);
+    for (int a = first; a <= last; ++a) {
+        // the same angles as a full rebuild, so tracing a region gives the same set
+        int index = ((a % numAngles) + numAngles) % numAngles;
+        traceRay(pvs, mapCells, x, y, index * angleStep);
+    }
+    markNearExtents(pvs);
+}
+
+int buildPvsCell(struct Pvs *pvs, const int *mapCells, int cell) {
+    int numCells = pvs->numCols * pvs->numRows;
+    struct PvsCell *pvsCell = &pvs->cells[cell];
+    if (isOccluder(mapCells[cell])) {
+        // nothing is seen from inside a wall
+        pvsCell->size = 0;
+        return TRUE;
+    }
+    memset(pvs->visible, 0, numCells);
+    for (int sample = 0; sample < PVS_NUM_SAMPLES; ++sample) {
+        traceSample(pvs, mapCells, cell, sample, NULL);
+    }
+    return encodeCell(pvsCell, pvs->visible, numCells, pvs->scratch);
+}
+
+static int allocatePvs(struct Pvs *pvs, int numCols, int numRows) {
+    int numCells = numCols * numRows;
+    pvs->numCols = numCols;
+    pvs->numRows = numRows;
+    pvs->cells = calloc(numCells, sizeof(struct PvsCell));
+    pvs->isStale = calloc(numCells, 1);
+    pvs->staleCells = malloc(sizeof(int) * numCells);
+    pvs->numStale = 0;
+    pvs->rebuilds = malloc(sizeof(struct PvsRebuild) * numCells);
+    pvs->rebuildCell = -1;
+    pvs->rebuildSample = 0;
+    pvs->visible = malloc(numCells);
+    pvs->scratch = malloc((size_t) (numCells + 1) * 5);
+    pvs->extents = malloc(sizeof(double) * 4 * (numCols + 2) * (numRows + 2));
+
+    // Any direction is within half a step of a traced one, so across the whole map, a sightline runs
+    // closer to the traced ray than the wall inset minus the sample reach (and a unit for the rounding).
+    double length = sqrt((double) numCols * numCols + (double) numRows * numRows) * TILE_SIZE + TILE_SIZE;
+    pvs->numAngles = (int) ceil(PI * length / (PVS_WALL_INSET - PVS_SAMPLE_REACH - 1));
+    return pvs->cells && pvs->isStale && pvs->staleCells && pvs->rebuilds && pvs->visible && pvs->scratch &&
+           pvs->extents;
+}
+
+int buildPvs(struct Pvs *pvs, const int *mapCells, int numCols, int numRows) {
+    int numCells = numCols * numRows;
+    int result = allocatePvs(pvs, numCols, numRows);
+    pvs->mapChecksum = pvsMapChecksum(mapCells, numCols, numRows);
+    for (int cell = 0; result && cell < numCells; ++cell) {
+        result = buildPvsCell(pvs, mapCells, cell);
+    }
+    if (!result) {
+        freePvs(pvs);
+    }
+    return result;
+}
+
+void freePvs(struct Pvs *pvs) {
+    if (pvs->cells) {
+        for (int i = 0; i < pvs->numCols * pvs->numRows; ++i) {
+            free(pvs->cells[i].runs);
+        }
+    }
+    free(pvs->cells);
+    free(pvs->isStale);
+    free(pvs->staleCells);
+    free(pvs->rebuilds);
+    free(pvs->visible);
+    free(pvs->scratch);
+    free(pvs->extents);
+    pvs->cells = NULL;
+    pvs->isStale = NULL;
+    pvs->staleCells = NULL;
+    pvs->rebuilds = NULL;
+    pvs->visible = NULL;
+    pvs->scratch = NULL;
+    pvs->extents = NULL;
+    pvs->numStale = 0;
+    pvs->rebuildCell = -1;
+}
+
+// queues the set of cell for a rebuild around the edit region, merged with any pending one
+static void markStale(struct Pvs *pvs, int cell, const struct PvsRebuild *region, int isFull, int isOpening) {
+    struct PvsRebuild *rebuild = &pvs->rebuilds[cell];
+    if (!pvs->isStale[cell]) {
+        pvs->isStale[cell] = TRUE;
+        pvs->staleCells[pvs->numStale++] = cell;
+        *rebuild = *region;
+        rebuild->isFull = isFull;
+        rebuild->isMissingCells = isOpening;
+    } else {
+        rebuild->minCol = region->minCol < rebuild->minCol ? region->minCol : rebuild->minCol;
+        rebuild->minRow = region->minRow < rebuild->minRow ? region->minRow : rebuild->minRow;
+        rebuild->maxCol = region->maxCol > rebuild->maxCol ? region->maxCol : rebuild->maxCol;
+        rebuild->maxRow = region->maxRow > rebuild->maxRow ? region->maxRow : rebuild->maxRow;
+        rebuild->isFull |= isFull;
+        rebuild->isMissingCells |= isOpening;
+    }
+    if (cell == pvs->rebuildCell) {
+        // the set being rebuilt starts over with the new region
+        pvs->rebuildSample = 0;
+    }
+}
+
+// TRUE when the set of cell holds a cell of the region
+static int setIntersects(const struct Pvs *pvs, int cell, const struct PvsRebuild *region) {
+    const struct PvsCell *pvsCell = &pvs->cells[cell];
+    int minCol = region->minCol < 0 ? 0 : region->minCol;
+    int maxCol = region->maxCol >= pvs->numCols ? pvs->numCols - 1 : region->maxCol;
+    int minRow = region->minRow < 0 ? 0 : region->minRow;
+    int maxRow = region->maxRow >= pvs->numRows ? pvs->numRows - 1 : region->maxRow;
+    int pos = 0;
+    int cellIndex = 0;
+    int isVisibleRun = FALSE;
+    uint32_t runLength;
+    while (readVarint(pvsCell->runs, pvsCell->size, &pos, &runLength) &&
+           runLength <= (uint32_t) (pvs->numCols * pvs->numRows - cellIndex)) {
+        int runEnd = cellIndex + (int) runLength;
+        for (int row = minRow; isVisibleRun && row <= maxRow; ++row) {
+            if (cellIndex <= row * pvs->numCols + maxCol && runEnd > row * pvs->numCols + minCol) {
+                return TRUE;
+            }
+        }
+        cellIndex = runEnd;
+        isVisibleRun = !isVisibleRun;
+    }
+    return FALSE;
+}
+
+void invalidatePvs(struct Pvs *pvs, int cell, int oldContent, int newContent) {
+    if (isOccluder(oldContent) == isOccluder(newContent)) {
+        // another wall texture, or a door, sees the same
+        return;
+    }
+    // the erosion of the walls changes in the edited cell and its neighbours, only the rays that
+    // reached them trace differently, and the sets of their sample points hold these cells
+    int col = cell % pvs->numCols;
+    int row = cell / pvs->numCols;
+    struct PvsRebuild region = {col - 1, row - 1, col + 1, row + 1, FALSE, FALSE};
+    int isOpening = !isOccluder(newContent);
+    // the set of the edited cell itself was empty as a wall, or becomes empty
+    markStale(pvs, cell, &region, TRUE, isOpening);
+    for (int i = 0; i < pvs->numCols * pvs->numRows; ++i) {
+        if (i != cell && setIntersects(pvs, i, &region)) {
+            markStale(pvs, i, &region, !isOpening, isOpening);
+        }
+    }
+}
+
+int refreshPvs(struct Pvs *pvs, const int *mapCells, uint64_t budgetNs) {
+    int numCells = pvs->numCols * pvs->numRows;
+    int numRebuilt = 0;
+    uint64_t start = profileNow();
+    while (pvs->numStale > 0 || pvs->rebuildCell >= 0) {
+        if (pvs->rebuildCell < 0) {
+            pvs->rebuildCell = pvs->staleCells[--pvs->numStale];
+            pvs->rebuildSample = 0;
+        }
+        int cell = pvs->rebuildCell;
+        const struct PvsRebuild *rebuild = &pvs->rebuilds[cell];
+        if (isOccluder(mapCells[cell])) {
+            pvs->cells[cell].size = 0;
+        } else {
+            if (pvs->rebuildSample == 0) {
+                // a region adds the cells seen through it to the current set
+                if (rebuild->isFull) {
+                    memset(pvs->visible, 0, numCells);
+                } else {
+                    decodeCell(&pvs->cells[cell], pvs->visible, numCells);
+                }
+            }
+            traceSample(pvs, mapCells, cell, pvs->rebuildSample, rebuild->isFull ? NULL : rebuild);
+            pvs->rebuildSample++;
+            if (pvs->rebuildSample == PVS_NUM_SAMPLES &&
+                !encodeCell(&pvs->cells[cell], pvs->visible, numCells, pvs->scratch)) {
+                // out of memory, the set starts over on the next refresh
+                pvs->rebuildSample = 0;
+                break;
+            }
+        }
+        if (isOccluder(mapCells[cell]) || pvs->rebuildSample == PVS_NUM_SAMPLES) {
+            pvs->isStale[cell] = FALSE;
+            pvs->rebuildCell = -1;
+            numRebuilt++;
+        }
+        if (profileNow() - start >= budgetNs) {
+            break;
+        }
+    }
+    if (pvs->numStale == 0 && pvs->rebuildCell < 0) {
+        pvs->mapChecksum = pvsMapChecksum(mapCells, pvs->numCols, pvs->numRows);
+    }
+    return numRebuilt;
+}
+
+int savePvs(const struct Pvs *pvs, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return FALSE;
+    }
+    int32_t header[3] = {pvs->numCols, pvs->numRows, (int32_t) pvs->mapChecksum};
+    int result = fwrite(PVS_MAGIC, sizeof(PVS_MAGIC), 1, file) == 1 && fwrite(header, sizeof(header), 1, file) == 1;
+    for (int i = 0; result && i < pvs->numCols * pvs->numRows; ++i) {
+        int32_t size = pvs->cells[i].size;
+        result = fwrite(&size, sizeof(size), 1, file) == 1 &&
+                 (size == 0 || fwrite(pvs->cells[i].runs, size, 1, file) == 1);
+    }
+    return fclose(file) == 0 && result;
+}
+
+// a set is valid when its runs cover exactly the cells of the map, walls have an empty set
+static int isValidCell(const struct PvsCell *pvsCell, int numCells) {
+    int pos = 0;
+    uint32_t total = 0;
+    uint32_t runLength;
+    while (pos < pvsCell->size) {
+        if (!readVarint(pvsCell->runs, pvsCell->size, &pos, &runLength) || runLength > numCells - total) {
+            return FALSE;
+        }
+        total += runLength;
+    }
+    return pvsCell->size == 0 || total == (uint32_t) numCells;
+}
+
+int loadPvs(struct Pvs *pvs, const char *path, const int *mapCells, int numCols, int numRows) {
+    if (numCols <= 0 || numRows <= 0) {
+        return FALSE;
+    }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return FALSE;
+    }
+    char magic[4];
+    int32_t header[3];
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, PVS_MAGIC, sizeof(magic)) != 0 ||
+        fread(header, sizeof(header), 1, file) != 1 || header[0] != numCols || header[1] != numRows ||
+        (uint32_t) header[2] != pvsMapChecksum(mapCells, numCols, numRows)) {
+        fclose(file);
+        return FALSE;
+    }
+
+    int numCells = numCols * numRows;
+    int result = allocatePvs(pvs, numCols, numRows);
+    pvs->mapChecksum = (uint32_t) header[2];
+    for (int i = 0; result && i < numCells; ++i) {
+        int32_t size;
+        // an encoded set never needs more than 5 bytes per run
+        result = fread(&size, sizeof(size), 1, file) == 1 && size >= 0 && size <= (numCells + 1) * 5;
+        if (result && size > 0) {
+            pvs->cells[i].runs = malloc(size);
+            pvs->cells[i].size = size;
+            pvs->cells[i].capacity = size;
+            result = pvs->cells[i].runs && fread(pvs->cells[i].runs, size, 1, file) == 1 &&
+                     isValidCell(&pvs->cells[i], numCells);
+        }
+    }
+    fclose(file);
+    if (!result) {
+        freePvs(pvs);
+    }
+    return result;
+}
+
+int pvsVisibleCells(const struct Pvs *pvs, int cell, int *visibleCells, int maxCells) {
+    const struct PvsCell *pvsCell = &pvs->cells[cell];
+    int count = 0;
+    int pos = 0;
+    int cellIndex = 0;
+    int isVisibleRun = FALSE;
+    uint32_t runLength;
+    while (readVarint(pvsCell->runs, pvsCell->size, &pos, &runLength) &&
+           runLength <= (uint32_t) (pvs->numCols * pvs->numRows - cellIndex)) {
+        if (isVisibleRun) {
+            for (uint32_t i = 0; i < runLength && count < maxCells; ++i) {
+                visibleCells[count++] = cellIndex + (int) i;
+            }
+        }
+        cellIndex += (int) runLength;
+        isVisibleRun = !isVisibleRun;
+    }
+    return count;
+}
+
+int pvsIsVisible(const struct Pvs *pvs, int fromCell, int toCell) {
+    const struct PvsCell *pvsCell = &pvs->cells[fromCell];
+    int pos = 0;
+    int cellIndex = 0;
+    int isVisibleRun = FALSE;
+    uint32_t runLength;
+    while (readVarint(pvsCell->runs, pvsCell->size, &pos, &runLength)) {
+        cellIndex += (int) runLength;
+        if (toCell < cellIndex) {
+            return isVisibleRun;
+        }
+        isVisibleRun = !isVisibleRun;
+    }
+    return FALSE;
+}
+
+int pvsIsComplete(const struct Pvs *pvs, int cell) {
+    return pvs->cells[cell].size > 0 && (!pvs->isStale[cell] || !pvs->rebuilds[cell].isMissingCells);
+}
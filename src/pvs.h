@@ -0,0 +1,85 @@
+#ifndef RAYCASTING_PVS_H
+#define RAYCASTING_PVS_H
+
+#include <stdint.h>
+
+// Potentially visible set: for every empty cell of the map, the cells that can be seen
+// from anywhere inside it (walls and the empty cells in between), and the cells a sprite showing
+// from there can stand in, see SPRITE_REACH. The sets are conservative, they never miss a cell.
+// Every set is stored as a run-length encoded bitset over all the cells of the map:
+// alternating runs of hidden and visible cells, starting with a hidden run,
+// every run length written as a LEB128 varint.
+struct PvsCell {
+    uint8_t *runs;
+    int size;
+    int capacity; // allocated size of runs, a rebuild reuses the buffer when the new set fits
+};
+
+// What a stale set needs: tracing the rays through the region around opened cells only, added to
+// the current set, or a full rebuild, to drop the cells hidden by a closed one.
+struct PvsRebuild {
+    int minCol;
+    int minRow;
+    int maxCol;
+    int maxRow;
+    int isFull;
+    int isMissingCells; // a wall was opened, the current set lacks the cells seen through it
+};
+
+struct Pvs {
+    int numCols;
+    int numRows;
+    int numAngles; // per sample point, grows with the map size
+    uint32_t mapChecksum;
+    struct PvsCell *cells;
+    uint8_t *isStale;  // sets invalidated by a map edit and not rebuilt yet
+    int *staleCells;
+    int numStale;
+    struct PvsRebuild *rebuilds; // of every stale set
+
+    // rebuilds are resumable, one sample point at a time
+    int rebuildCell; // set being rebuilt, -1 when none
+    int rebuildSample; // next sample point of it
+    uint8_t *visible;  // the set being rebuilt, one byte per map cell
+    uint8_t *scratch;  // encoder output, 5 bytes per map cell plus one run
+    double *extents;   // box of the rays of a sample point inside every cell, ring of walls included
+};
+
+uint32_t pvsMapChecksum(const int *mapCells, int numCols, int numRows);
+
+// Doors never occlude, so opening and closing them keeps the sets valid.
+// Samples visibility from points spread over every empty cell, against walls eroded by more than
+// the gaps between the samples, so rays slip past the corners sightlines graze and no cell seen
+// from the cell is missed. Slow, meant to run offline.
+int buildPvs(struct Pvs *pvs, const int *mapCells, int numCols, int numRows);
+
+// Recomputes the set of a single cell.
+int buildPvsCell(struct Pvs *pvs, const int *mapCells, int cell);
+
+void freePvs(struct Pvs *pvs);
+
+// Marks the sets that may change after an edit of cell from oldContent to newContent as stale:
+// the ones holding the cell or one of its neighbours. Opening a wall only adds the cells seen
+// through it, the rebuild traces the rays crossing the cells around it alone. Closing one leaves
+// supersets of the new sets, still conservative until they are rebuilt in full.
+void invalidatePvs(struct Pvs *pvs, int cell, int oldContent, int newContent);
+
+// Rebuilds stale sets for about budgetNs nanoseconds, at least one sample point of a set when
+// any is stale, and returns how many sets were completed.
+int refreshPvs(struct Pvs *pvs, const int *mapCells, uint64_t budgetNs);
+
+int savePvs(const struct Pvs *pvs, const char *path);
+
+// Fails when the file is missing, malformed, or was built for a different map.
+int loadPvs(struct Pvs *pvs, const char *path, const int *mapCells, int numCols, int numRows);
+
+// Writes the indices of the cells visible from cell and returns their count.
+int pvsVisibleCells(const struct Pvs *pvs, int cell, int *visibleCells, int maxCells);
+
+int pvsIsVisible(const struct Pvs *pvs, int fromCell, int toCell);
+
+// TRUE when the set of cell holds every cell visible from it: a built set of an empty cell that no
+// wall was opened around since. The others can miss cells, and are no bound of what is visible.
+int pvsIsComplete(const struct Pvs *pvs, int cell);
+
+#endif //RAYCASTING_PVS_H
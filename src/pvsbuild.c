@@ -0,0 +1,30 @@
+#include <stdio.h>
+
+#include "map.h"
+#include "pvs.h"
+
+// Offline builder of the potentially visible set of the map, run it next to the executable.
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : PVS_FILE;
+
+    struct Pvs pvs;
+    printf("Building PVS for a %dx%d map...\n", MAP_NUM_COLS, MAP_NUM_ROWS);
+    if (!buildPvs(&pvs, &defaultMap[0][0], MAP_NUM_COLS, MAP_NUM_ROWS)) {
+        fprintf(stderr, "Error building the PVS\n");
+        return 1;
+    }
+
+    int totalSize = 0;
+    for (int i = 0; i < MAP_NUM_COLS * MAP_NUM_ROWS; ++i) {
+        totalSize += pvs.cells[i].size;
+    }
+    if (!savePvs(&pvs, path)) {
+        fprintf(stderr, "Error writing %s\n", path);
+        freePvs(&pvs);
+        return 1;
+    }
+    printf("Wrote %s, %d bytes of run-length encoded sets\n", path, totalSize);
+
+    freePvs(&pvs);
+    return 0;
+}
@@ -0,0 +1,542 @@
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raycaster.h"
+#include "profiler.h"
+#include "alignedalloc.h"
+
+// Grid crossings this close to a cell corner are put on a side of it exactly, see castRay().
+#define CORNER_SNAP_DISTANCE 0.0625f
+
+// Tallest wall strip drawn, for walls at or next to the camera. The kernels step through the
+// strip in 16.16 fixed point, so it stays well below the range of an int.
+#define MAX_WALL_STRIP_HEIGHT (1 << 20)
+
+struct Raycaster *createRaycaster(struct World *world, int width, int height) {
+    struct Raycaster *rc = calloc(1, sizeof(struct Raycaster));
+    if (!rc) {
+        return NULL;
+    }
+    rc->world = world;
+    rc->width = width;
+    rc->height = height;
+    rc->renderMode = RENDER_MODE_FULL;
+    rc->colorBuffer = allocAligned(sizeof(uint32_t) * width * height);
+    rc->grayBuffer = allocAligned(width * height);
+    rc->indexBuffer = allocAligned(width * height);
+    rc->rays = allocAlignedZero(sizeof(struct Ray) * width);
+    rc->zBuffer = allocAligned(sizeof(float) * width);
+    rc->visibleSpriteIds = malloc(sizeof(int) * MAX_SPRITES);
+    rc->visibleSprites = malloc(sizeof(struct VisibleSprite) * MAX_SPRITES);
+    rc->pvsCells = malloc(sizeof(int) * world->map.numCols * world->map.numRows);
+    int hasSpriteQuery = initSpatialQuery(&rc->spriteQuery, world->spriteGrid.numCols, world->spriteGrid.numRows);
+    // room for the sprite sort of a full sprite list, whatever else the frame needs comes on top
+    initArena(&rc->frameArena, sizeof(struct VisibleSprite) * MAX_SPRITES + FRAME_ARENA_SIZE, PROFILE_ARENA_FRAME);
+    if (!rc->colorBuffer || !rc->grayBuffer || !rc->indexBuffer || !rc->rays || !rc->zBuffer || !rc->visibleSpriteIds || !rc->visibleSprites ||
+        !rc->pvsCells || !hasSpriteQuery || !rc->frameArena.base) {
+        destroyRaycaster(rc);
+        return NULL;
+    }
+    return rc;
+}
+
+void destroyRaycaster(struct Raycaster *rc) {
+    if (!rc) {
+        return;
+    }
+    freeAligned(rc->colorBuffer);
+    freeAligned(rc->grayBuffer);
+    freeAligned(rc->indexBuffer);
+    freeAligned(rc->rays);
+    freeAligned(rc->zBuffer);
+    free(rc->visibleSpriteIds);
+    free(rc->visibleSprites);
+    free(rc->pvsCells);
+    freeSpatialQuery(&rc->spriteQuery);
+    freeArena(&rc->frameArena);
+    free(rc->miniMapTiles);
+    free(rc);
+}
+
+void castAllRays(struct Raycaster *rc) {
+    if (rc->isIncremental) {
+        beginIncrementalCast(rc);
+        castRays(rc, rc->castFirst, rc->castLast);
+    } else {
+        castRays(rc, 0, rc->width);
+    }
+}
+
+int beginIncrementalCast(struct Raycaster *rc) {
+    const struct Map *map = &rc->world->map;
+    int width = rc->width;
+    // the camera angle snaps to the closest column step, it moves by half a column at most
+    int firstRayIndex = (int) floor(rc->camera.angle / (FOV_ANGLE / width) + 0.5f) - width / 2;
+    int shift = firstRayIndex - rc->firstRayIndex;
+
+    rc->castFirst = 0;
+    rc->castLast = width;
+    if (rc->hasCachedRays && rc->cachedX == rc->camera.x && rc->cachedY == rc->camera.y &&
+        rc->cachedRevision == map->revision && abs(shift) < width) {
+        // same position and map, so a ray cast at the same angle hits the same spot
+        if (shift > 0) {
+            memmove(rc->rays, rc->rays + shift, sizeof(struct Ray) * (width - shift));
+            rc->castFirst = width - shift;
+        } else if (shift < 0) {
+            memmove(rc->rays - shift, rc->rays, sizeof(struct Ray) * (width + shift));
+            rc->castLast = -shift;
+        } else {
+            rc->castLast = 0;
+        }
+    }
+    rc->hasCachedRays = TRUE;
+    rc->cachedX = rc->camera.x;
+    rc->cachedY = rc->camera.y;
+    rc->cachedRevision = map->revision;
+    rc->firstRayIndex = firstRayIndex;
+    return rc->castLast - rc->castFirst;
+}
+
+void castRays(struct Raycaster *rc, int firstColumn, int lastColumn) {
+    // start first ray subtracting half of our FOV; the angle of every column is computed
+    // directly rather than accumulated, so any column range gives the same rays
+    float anglePerColumn = FOV_ANGLE / rc->width;
+    if (rc->isIncremental) {
+        // the angle only depends on the ray index, so a reused ray is bit for bit a fresh one
+        for (int stripId = firstColumn; stripId < lastColumn; stripId++) {
+            castRay(rc, (rc->firstRayIndex + stripId) * anglePerColumn, stripId);
+        }
+        return;
+    }
+    float firstAngle = rc->camera.angle - (FOV_ANGLE / 2);
+
+    for (int stripId = firstColumn; stripId < lastColumn; stripId++) {
+        castRay(rc, firstAngle + stripId * anglePerColumn, stripId);
+    }
+}
+
+float normalizeAngle(float angle) {
+    angle = remainder(angle, TWO_PI);
+    if (angle < 0) {
+        angle = TWO_PI + angle;
+    }
+    return angle;
+}
+
+float distanceBetweenPoints(float x1, float y1, float x2, float y2) {
+    return sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+}
+
+// A ray crossing a grid line next to a cell corner enters the cell on one side of the corner or
+// the other. The horizontal and the vertical pass round their crossings independently, and could
+// each put the ray on the side of a free cell: the ray would leak through the diagonal gap between
+// two walls. Near a corner the side is decided from the ray direction instead, the same way in
+// both passes. Returns the coordinate of the cell to check along the grid line: x on the
+// horizontal grid line at y (isAlongX), y on the vertical grid line at x.
+static float crossingNearCorner(const struct Camera *camera, double dirX, double dirY, float x, float y,
+                                int isAlongX) {
+    float position = isAlongX ? x : y;
+    float corner = round(position / TILE_SIZE) * TILE_SIZE;
+    if (fabs(position - corner) >= CORNER_SNAP_DISTANCE) {
+        return position;
+    }
+    double cornerX = isAlongX ? corner : x;
+    double cornerY = isAlongX ? y : corner;
+    double side = (cornerX - camera->x) * dirY - (cornerY - camera->y) * dirX;
+    // through the corner itself, the ray goes on into the cell ahead along the grid line
+    int isBeforeCorner = side == 0 ? (isAlongX ? dirX : dirY) < 0 : (isAlongX ? side * dirY > 0 : side * dirX < 0);
+    return isBeforeCorner ? corner - 1 : corner;
+}
+
+void castRay(struct Raycaster *rc, float rayAngle, int stripId) {
+    const struct Map *map = &rc->world->map;
+    float mapWidth = map->numCols * TILE_SIZE;
+    float mapHeight = map->numRows * TILE_SIZE;
+    rayAngle = normalizeAngle(rayAngle);
+
+    int isRayFacingDown = rayAngle > 0 && rayAngle < PI;
+    int isRayFacingUp = !isRayFacingDown;
+
+    int isRayFacingRight = rayAngle < PI / 2 || rayAngle > PI * 3 / 2;
+    int isRayFacingLeft = !isRayFacingRight;
+
+    float xintercept, yintercept;
+    float xstep, ystep;
+
+    ///////////////////////////////////////////
+    // HORIZONTAL RAY-GRID INTERSECTION CODE
+    ///////////////////////////////////////////
+    int foundHorzWallHit = FALSE;
+    float horzWallHitX = 0;
+    float horzWallHitY = 0;
+    int horzWallContent = 0;
+    int horzWallHitVertical = FALSE;
+
+    // Find the y-coordinate of the closest horizontal grid intersection
+    yintercept = floor(rc->camera.y / TILE_SIZE) * TILE_SIZE;
+    yintercept += isRayFacingDown ? TILE_SIZE : 0;
+
+    // Find the x-coordinate of the closest horizontal grid intersection, a ray along the x axis
+    // never crosses a horizontal grid line (and would divide by a zero tangent)
+    double tanAngle = tan(rayAngle);
+    double dirX = cos(rayAngle);
+    double dirY = sin(rayAngle);
+    int isParallelToRows = tanAngle == 0;
+    xintercept = isParallelToRows ? 0 : rc->camera.x + (yintercept - rc->camera.y) / tanAngle;
+
+    // Calculate the increment xstep and ystep
+    ystep = TILE_SIZE;
+    ystep *= isRayFacingUp ? -1 : 1;
+
+    xstep = isParallelToRows ? 0 : TILE_SIZE / tanAngle;
+    xstep *= (isRayFacingLeft && xstep > 0) ? -1 : 1;
+    xstep *= (isRayFacingRight && xstep < 0) ? -1 : 1;
+
+    float nextHorzTouchX = xintercept;
+    float nextHorzTouchY = yintercept;
+
+    // Increment xstep and ystep until we find a wall, the far map edges are walls too. A crossing
+    // rounded just past a map corner still counts, or a ray into the corner would escape both passes.
+    while (!isParallelToRows && nextHorzTouchX >= -CORNER_SNAP_DISTANCE &&
+           nextHorzTouchX <= mapWidth + CORNER_SNAP_DISTANCE && nextHorzTouchY >= 0 && nextHorzTouchY <= mapHeight) {
+        float yToCheck = nextHorzTouchY + (isRayFacingUp ? -1 : 0);
+        float xToCheck = crossingNearCorner(&rc->camera, dirX, dirY, nextHorzTouchX, nextHorzTouchY, TRUE);
+
+        if (mapHasWallAt(map, xToCheck, yToCheck)) {
+            int col = (int) floor(xToCheck / TILE_SIZE);
+            int row = (int) floor(yToCheck / TILE_SIZE);
+            horzWallContent = mapContentAt(map, col, row);
+            if (horzWallContent != DOOR_CELL) {
+                // found a wall hit
+                horzWallHitX = nextHorzTouchX;
+                horzWallHitY = nextHorzTouchY;
+                foundHorzWallHit = TRUE;
+                break;
+            }
+            // doors only stop the ray where their panel is
+            if (mapDoorHit(map, col, row, nextHorzTouchX, nextHorzTouchY, dirX, dirY,
+                           &horzWallHitX, &horzWallHitY)) {
+                horzWallHitVertical = map->doors[findDoor(map, col, row)].isVertical;
+                foundHorzWallHit = TRUE;
+                break;
+            }
+        }
+        nextHorzTouchX += xstep;
+        nextHorzTouchY += ystep;
+    }
+
+    ///////////////////////////////////////////
+    // VERTICAL RAY-GRID INTERSECTION CODE
+    ///////////////////////////////////////////
+    int foundVertWallHit = FALSE;
+    float vertWallHitX = 0;
+    float vertWallHitY = 0;
+    int vertWallContent = 0;
+    int vertWallHitVertical = TRUE;
+
+    // Find the x-coordinate of the closest horizontal grid intersection
+    xintercept = floor(rc->camera.x / TILE_SIZE) * TILE_SIZE;
+    xintercept += isRayFacingRight ? TILE_SIZE : 0;
+
+    // Find the y-coordinate of the closest horizontal grid intersection
+    yintercept = rc->camera.y + (xintercept - rc->camera.x) * tanAngle;
+
+    // Calculate the increment xstep and ystep
+    xstep = TILE_SIZE;
+    xstep *= isRayFacingLeft ? -1 : 1;
+
+    ystep = TILE_SIZE * tanAngle;
+    ystep *= (isRayFacingUp && ystep > 0) ? -1 : 1;
+    ystep *= (isRayFacingDown && ystep < 0) ? -1 : 1;
+
+    float nextVertTouchX = xintercept;
+    float nextVertTouchY = yintercept;
+
+    // Increment xstep and ystep until we find a wall, the far map edges are walls too
+    while (nextVertTouchX >= 0 && nextVertTouchX <= mapWidth && nextVertTouchY >= -CORNER_SNAP_DISTANCE &&
+           nextVertTouchY <= mapHeight + CORNER_SNAP_DISTANCE) {
+        float xToCheck = nextVertTouchX + (isRayFacingLeft ? -1 : 0);
+        float yToCheck = crossingNearCorner(&rc->camera, dirX, dirY, nextVertTouchX, nextVertTouchY, FALSE);
+
+        if (mapHasWallAt(map, xToCheck, yToCheck)) {
+            int col = (int) floor(xToCheck / TILE_SIZE);
+            int row = (int) floor(yToCheck / TILE_SIZE);
+            vertWallContent = mapContentAt(map, col, row);
+            if (vertWallContent != DOOR_CELL) {
+                // found a wall hit
+                vertWallHitX = nextVertTouchX;
+                vertWallHitY = nextVertTouchY;
+                foundVertWallHit = TRUE;
+                break;
+            }
+            // doors only stop the ray where their panel is
+            if (mapDoorHit(map, col, row, nextVertTouchX, nextVertTouchY, dirX, dirY,
+                           &vertWallHitX, &vertWallHitY)) {
+                vertWallHitVertical = map->doors[findDoor(map, col, row)].isVertical;
+                foundVertWallHit = TRUE;
+                break;
+            }
+        }
+        nextVertTouchX += xstep;
+        nextVertTouchY += ystep;
+    }
+
+    // Calculate both horizontal and vertical hit distances and choose the smallest one
+    float horzHitDistance = foundHorzWallHit
+                            ? distanceBetweenPoints(rc->camera.x, rc->camera.y, horzWallHitX, horzWallHitY)
+                            : INT_MAX;
+    float vertHitDistance = foundVertWallHit
+                            ? distanceBetweenPoints(rc->camera.x, rc->camera.y, vertWallHitX, vertWallHitY)
+                            : INT_MAX;
+
+    if (vertHitDistance < horzHitDistance) {
+        rc->rays[stripId].distance = vertHitDistance;
+        rc->rays[stripId].wallHitX = vertWallHitX;
+        rc->rays[stripId].wallHitY = vertWallHitY;
+        rc->rays[stripId].wallHitContent = vertWallContent;
+        rc->rays[stripId].wasHitVertical = vertWallHitVertical;
+    } else {
+        rc->rays[stripId].distance = horzHitDistance;
+        rc->rays[stripId].wallHitX = horzWallHitX;
+        rc->rays[stripId].wallHitY = horzWallHitY;
+        rc->rays[stripId].wallHitContent = horzWallContent;
+        rc->rays[stripId].wasHitVertical = horzWallHitVertical;
+    }
+    rc->rays[stripId].rayAngle = rayAngle;
+    rc->rays[stripId].isRayFacingDown = isRayFacingDown;
+    rc->rays[stripId].isRayFacingUp = isRayFacingUp;
+    rc->rays[stripId].isRayFacingLeft = isRayFacingLeft;
+    rc->rays[stripId].isRayFacingRight = isRayFacingRight;
+}
+
+// Height in pixels of the wall strip at a perpendicular distance, clamped for walls at the camera:
+// a zero distance would overflow the conversion to int.
+static int wallStripHeightAt(float normDistance, float distanceProjPlane) {
+    float projectedWallHeight = (TILE_SIZE / normDistance) * distanceProjPlane;
+    return projectedWallHeight < MAX_WALL_STRIP_HEIGHT ? (int) projectedWallHeight : MAX_WALL_STRIP_HEIGHT;
+}
+
+void generate3DProjection(struct Raycaster *rc) {
+    projectWalls(rc, 0, rc->width);
+}
+
+void projectWalls(struct Raycaster *rc, int firstColumn, int lastColumn) {
+    int width = rc->width;
+    int height = rc->height;
+    uint32_t *colorBuffer = rc->colorBuffer;
+    const struct Ray *rays = rc->rays;
+
+    for (int i = firstColumn; i < lastColumn; ++i) {
+        float normDistance = rays[i].distance * cos(rays[i].rayAngle - rc->camera.angle);
+        rc->zBuffer[i] = normDistance;
+        float distanceProjPlane = (width / 2) / tan(FOV_ANGLE / 2);
+        int wallStripHeight = wallStripHeightAt(normDistance, distanceProjPlane);
+
+        int wallTopPixel = (height / 2) - (wallStripHeight / 2);
+        wallTopPixel = wallTopPixel < 0 ? 0 : wallTopPixel;
+
+        int wallBottomPixel = (height / 2) + (wallStripHeight / 2);
+        wallBottomPixel = wallBottomPixel > height ? height : wallBottomPixel;
+
+        // rendering the ceiling
+        for (int c = 0; c < wallTopPixel; ++c) {
+            colorBuffer[width * c + i] = CEILING_COLOR;
+        }
+        // rendering floor
+        for (int c = wallBottomPixel; c < height; ++c) {
+            colorBuffer[width * c + i] = FLOOR_COLOR;
+        }
+        // rendering the walls
+        int textureOffsetX;
+        if (rays[i].wasHitVertical) {
+            textureOffsetX = (int)rays[i].wallHitY % TILE_SIZE;
+        } else {
+            textureOffsetX = (int)rays[i].wallHitX % TILE_SIZE;
+        }
+        int textNum = rays[i].wallHitContent - 1;
+        if (rays[i].wallHitContent == DOOR_CELL) {
+            textNum = DOOR_TEXTURE;
+            textureOffsetX = mapDoorTextureOffset(&rc->world->map, rays[i].wallHitX, rays[i].wallHitY);
+        }
+        if (wallTopPixel >= wallBottomPixel) {
+            continue;
+        }
+        // distance fog and side darkening, picked once per column
+        int lightLevel = lightLevelAt(normDistance, rays[i].wasHitVertical);
+        struct WallColumn column = {
+                rc->world->textures[textNum], rc->world->textureWidth, rc->world->textureHeight,
+                textureOffsetX * rc->world->textureWidth / TILE_SIZE, wallStripHeight,
+                wallTopPixel, wallBottomPixel, height, colorBuffer + i, width, &rc->world->shades[lightLevel], NULL
+        };
+        if (lightLevel == NUM_LIGHT_LEVELS - 1) {
+            // the full bright shade leaves colors as they are, skip it
+            rc->fullBrightWallKernel(&column);
+        } else {
+            rc->wallKernel(&column);
+        }
+    }
+
+}
+
+void projectWallsGray(struct Raycaster *rc, int firstColumn, int lastColumn) {
+    int width = rc->width;
+    int height = rc->height;
+    uint8_t *grayBuffer = rc->grayBuffer;
+    const struct Ray *rays = rc->rays;
+    float distanceProjPlane = (width / 2) / tan(FOV_ANGLE / 2);
+
+    for (int i = firstColumn; i < lastColumn; ++i) {
+        float normDistance = rays[i].distance * cos(rays[i].rayAngle - rc->camera.angle);
+        rc->zBuffer[i] = normDistance;
+        int wallStripHeight = wallStripHeightAt(normDistance, distanceProjPlane);
+
+        int wallTopPixel = (height / 2) - (wallStripHeight / 2);
+        wallTopPixel = wallTopPixel < 0 ? 0 : wallTopPixel;
+        int wallBottomPixel = (height / 2) + (wallStripHeight / 2);
+        wallBottomPixel = wallBottomPixel > height ? height : wallBottomPixel;
+
+        int textNum = rays[i].wallHitContent == DOOR_CELL ? DOOR_TEXTURE : rays[i].wallHitContent - 1;
+        uint8_t wallShade = rc->world->textureLuma[textNum];
+        // darker vertical faces, so corners stay readable without textures
+        if (rays[i].wasHitVertical) {
+            wallShade = wallShade * 3 / 4;
+        }
+
+        uint8_t *pixel = grayBuffer + i;
+        for (int y = 0; y < wallTopPixel; ++y, pixel += width) {
+            *pixel = 0x33;
+        }
+        for (int y = wallTopPixel; y < wallBottomPixel; ++y, pixel += width) {
+            *pixel = wallShade;
+        }
+        for (int y = wallBottomPixel; y < height; ++y, pixel += width) {
+            *pixel = 0x77;
+        }
+    }
+}
+
+int lightLevelAt(float distance, int isVerticalFace) {
+    int lightLevel = NUM_LIGHT_LEVELS - 1 - (int) (distance / LIGHT_FALLOFF_DISTANCE);
+    if (isVerticalFace) {
+        lightLevel -= SIDE_LIGHT_DROP;
+    }
+    return lightLevel < MIN_LIGHT_LEVEL ? MIN_LIGHT_LEVEL : lightLevel;
+}
+
+void projectWallsIndexed(struct Raycaster *rc, int firstColumn, int lastColumn) {
+    int width = rc->width;
+    int height = rc->height;
+    const struct World *world = rc->world;
+    const struct Ray *rays = rc->rays;
+    float distanceProjPlane = (width / 2) / tan(FOV_ANGLE / 2);
+
+    for (int i = firstColumn; i < lastColumn; ++i) {
+        float normDistance = rays[i].distance * cos(rays[i].rayAngle - rc->camera.angle);
+        rc->zBuffer[i] = normDistance;
+        int wallStripHeight = wallStripHeightAt(normDistance, distanceProjPlane);
+
+        int wallTopPixel = (height / 2) - (wallStripHeight / 2);
+        wallTopPixel = wallTopPixel < 0 ? 0 : wallTopPixel;
+        int wallBottomPixel = (height / 2) + (wallStripHeight / 2);
+        wallBottomPixel = wallBottomPixel > height ? height : wallBottomPixel;
+
+        int textureOffsetX;
+        if (rays[i].wasHitVertical) {
+            textureOffsetX = (int) rays[i].wallHitY % TILE_SIZE;
+        } else {
+            textureOffsetX = (int) rays[i].wallHitX % TILE_SIZE;
+        }
+        int textNum = rays[i].wallHitContent - 1;
+        if (rays[i].wallHitContent == DOOR_CELL) {
+            textNum = DOOR_TEXTURE;
+            textureOffsetX = mapDoorTextureOffset(&world->map, rays[i].wallHitX, rays[i].wallHitY);
+        }
+        // the light level is picked once per column, the kernel only does a table lookup
+        int lightLevel = lightLevelAt(normDistance, rays[i].wasHitVertical);
+
+        uint8_t *pixel = rc->indexBuffer + i;
+        for (int y = 0; y < wallTopPixel; ++y, pixel += width) {
+            *pixel = world->ceilingIndex;
+        }
+        if (wallTopPixel < wallBottomPixel) {
+            struct WallColumn column = {
+                    world->indexedTextures[textNum], world->textureWidth, world->textureHeight,
+                    textureOffsetX * world->textureWidth / TILE_SIZE, wallStripHeight,
+                    wallTopPixel, wallBottomPixel, height, rc->indexBuffer + i, width, NULL,
+                    world->palette.colormap[lightLevel]
+            };
+            rc->wallKernel(&column);
+        }
+        pixel = rc->indexBuffer + width * wallBottomPixel + i;
+        for (int y = wallBottomPixel; y < height; ++y, pixel += width) {
+            *pixel = world->floorIndex;
+        }
+    }
+}
+
+void expandIndexBuffer(struct Raycaster *rc) {
+    expandPalette(&rc->world->palette, rc->indexBuffer, rc->colorBuffer, rc->width * rc->height);
+}
+
+int renderModeHasSprites(int renderMode) {
+    return renderMode == RENDER_MODE_FULL || renderMode == RENDER_MODE_INDEXED;
+}
+
+void clearColorBuffer(struct Raycaster *rc, uint32_t color) {
+    for (int y = 0; y < rc->height; ++y) {
+        for (int x = 0; x < rc->width; ++x) {
+            rc->colorBuffer[rc->width * y + x] = color;
+        }
+    }
+}
+
+void renderColumns(struct Raycaster *rc, int firstColumn, int lastColumn) {
+    uint64_t start = profileBegin();
+    if (rc->isIncremental) {
+        // only the columns beginIncrementalCast() left
+        int first = firstColumn > rc->castFirst ? firstColumn : rc->castFirst;
+        int last = lastColumn < rc->castLast ? lastColumn : rc->castLast;
+        if (first < last) {
+            castRays(rc, first, last);
+        }
+    } else {
+        castRays(rc, firstColumn, lastColumn);
+    }
+    profileEnd(PROFILE_CAST, start);
+
+    start = profileBegin();
+    if (rc->renderMode == RENDER_MODE_FULL) {
+        projectWalls(rc, firstColumn, lastColumn);
+    } else if (rc->renderMode == RENDER_MODE_GRAY) {
+        projectWallsGray(rc, firstColumn, lastColumn);
+    } else if (rc->renderMode == RENDER_MODE_INDEXED) {
+        projectWallsIndexed(rc, firstColumn, lastColumn);
+    }
+    profileEnd(PROFILE_PROJECTION, start);
+}
+
+void beginFrame(struct Raycaster *rc) {
+    const struct World *world = rc->world;
+    arenaReset(&rc->frameArena);
+    int format = rc->renderMode == RENDER_MODE_INDEXED ? WALL_FORMAT_INDEXED8 : WALL_FORMAT_ARGB8888;
+    rc->wallKernel = selectWallKernel(world->textureWidth, world->textureHeight, format, WALL_SHADE_LIGHT,
+                                      rc->isGenericKernel);
+    rc->fullBrightWallKernel = selectWallKernel(world->textureWidth, world->textureHeight, format, WALL_SHADE_NONE,
+                                                rc->isGenericKernel);
+    if (rc->isIncremental) {
+        beginIncrementalCast(rc);
+    }
+}
+
+void renderFrame(struct Raycaster *rc) {
+    beginFrame(rc);
+    renderColumns(rc, 0, rc->width);
+    if (renderModeHasSprites(rc->renderMode)) {
+        uint64_t start = profileBegin();
+        int numVisibleSprites = findVisibleSprites(rc);
+        renderSprites(rc, rc->visibleSpriteIds, numVisibleSprites);
+        profileEnd(PROFILE_SPRITES, start);
+    }
+}
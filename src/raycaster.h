@@ -0,0 +1,131 @@
+#ifndef RAYCASTING_RAYCASTER_H
+#define RAYCASTING_RAYCASTER_H
+
+#include <stdint.h>
+
+#include "constants.h"
+#include "world.h"
+#include "wallkernels.h"
+#include "arena.h"
+
+struct Camera {
+    float x;
+    float y;
+    float angle; // in radians
+};
+
+struct Ray {
+    float rayAngle;
+    float wallHitX;
+    float wallHitY;
+    float distance;
+    int wasHitVertical;
+    int isRayFacingUp;
+    int isRayFacingDown;
+    int isRayFacingLeft;
+    int isRayFacingRight;
+    int wallHitContent;
+};
+
+// A single view of a world: its camera, ray buffer and framebuffer.
+// Contexts are independent, any number of them can share one world.
+struct Raycaster {
+    struct World *world;
+    struct Camera camera;
+    int width;
+    int height;
+    int renderMode;        // RENDER_MODE_*, full by default
+    uint32_t *colorBuffer; // ARGB8888, width * height
+    uint8_t *grayBuffer;   // width * height, only written in RENDER_MODE_GRAY
+    uint8_t *indexBuffer;  // width * height palette indices, only written in RENDER_MODE_INDEXED
+    struct Ray *rays;      // one per column
+    float *zBuffer;        // perpendicular wall distance of every column
+
+    // sprite culling scratch, per view so the views of a world cull their sprites in parallel
+    struct SpatialQuery spriteQuery;
+    int *visibleSpriteIds;
+    struct VisibleSprite *visibleSprites;
+    int numVisibleSprites;
+    int *pvsCells;
+
+    // transient memory of the frame, reset by beginFrame()
+    struct Arena frameArena;
+
+    // Incremental casting, off by default. Rays are then cast at whole multiples of the column
+    // angle, so after a pure rotation most of them are still valid, one column over.
+    int isIncremental;
+    int hasCachedRays;
+    float cachedX;
+    float cachedY;
+    int cachedRevision;
+    int firstRayIndex; // angle of the ray of column 0, in column steps
+    int castFirst;     // columns [castFirst, castLast) are the ones left to cast this frame
+    int castLast;
+
+    // textured wall kernels of the frame, for lit and full bright columns, see beginFrame()
+    WallKernel wallKernel;
+    WallKernel fullBrightWallKernel;
+    int isGenericKernel; // always use the generic kernels, for comparisons
+
+    // software minimap, see drawMiniMap()
+    uint32_t *miniMapTiles;
+    int miniMapWidth;
+    int miniMapHeight;
+    int miniMapRevision;
+    float miniMapScale;
+};
+
+struct Raycaster *createRaycaster(struct World *world, int width, int height);
+
+void destroyRaycaster(struct Raycaster *rc);
+
+float normalizeAngle(float angle);
+
+float distanceBetweenPoints(float x1, float y1, float x2, float y2);
+
+void castAllRays(struct Raycaster *rc);
+
+// Starts a frame of an incremental context: reuses the rays of the last frame when the camera
+// only turned and nothing moved, shifting them by whole columns, and sets the columns that still
+// need a cast. Returns their count, 0 when the camera and the map did not change at all.
+int beginIncrementalCast(struct Raycaster *rc);
+
+// Casts the rays of the columns [firstColumn, lastColumn) only.
+void castRays(struct Raycaster *rc, int firstColumn, int lastColumn);
+
+void castRay(struct Raycaster *rc, float rayAngle, int stripId);
+
+void generate3DProjection(struct Raycaster *rc);
+
+// Draws the ceiling, walls and floor of the columns [firstColumn, lastColumn) only.
+void projectWalls(struct Raycaster *rc, int firstColumn, int lastColumn);
+
+// Flat shaded walls into the gray buffer, one shade per texture and side.
+void projectWallsGray(struct Raycaster *rc, int firstColumn, int lastColumn);
+
+// Textured walls as palette indices into the index buffer, dimmed with distance through the colormap.
+void projectWallsIndexed(struct Raycaster *rc, int firstColumn, int lastColumn);
+
+// Light level of a surface at distance, see NUM_LIGHT_LEVELS. Both textured modes use it,
+// through the colormap of the palette or the shade table of the world.
+int lightLevelAt(float distance, int isVerticalFace);
+
+// Final pass of RENDER_MODE_INDEXED: palette lookup of the index buffer into the color buffer.
+void expandIndexBuffer(struct Raycaster *rc);
+
+int renderModeHasSprites(int renderMode);
+
+// Per frame setup before renderColumns(): resets the frame arena, picks the wall kernels of the
+// render mode and starts the incremental cast of incremental contexts.
+void beginFrame(struct Raycaster *rc);
+
+// Casts the columns [firstColumn, lastColumn) and projects them as the render mode asks.
+// beginFrame() must have been called for the frame.
+void renderColumns(struct Raycaster *rc, int firstColumn, int lastColumn);
+
+void clearColorBuffer(struct Raycaster *rc, uint32_t color);
+
+// Casts, projects the walls and draws the sprites of the current camera, as the render mode asks.
+void renderFrame(struct Raycaster *rc);
+
+#endif //RAYCASTING_RAYCASTER_H
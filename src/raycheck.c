@@ -0,0 +1,341 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raycaster.h"
+#include "rayquery.h"
+
+// Property check of the grid casters: casts rays from random poses on random maps with castRay()
+// and castRayBatch(), and compares every hit with a slow exact reference walking the grid in
+// double precision. The batches hold 4 to 11 rays, so every lane of the SSE2 kernel and the
+// scalar tail are checked. Poses include cell centers and corners, positions on grid lines, exact axis
+// and diagonal angles, angles aimed at grid corners and angles a hair off an axis.
+// The run is deterministic for a seed; a mismatch prints the map seed and the pose, and makes the
+// exit status 1. Build with RAYCASTING_SANITIZE to run it under ASan and UBSan.
+//
+// usage: raycheck [-n maps] [-p poses] [-s seed]
+
+#define DEFAULT_NUM_MAPS 500
+#define DEFAULT_NUM_POSES 200 // per map
+#define MIN_MAP_SIZE 2        // cells, per side
+#define MAX_MAP_SIZE 24
+#define WALL_PERCENT 30
+#define MAX_REPORTED_MISMATCHES 10
+#define MIN_BATCH_SIZE 4  // castRayBatch() calls, the 4 lane kernel runs on every group of 4
+#define MAX_BATCH_SIZE 11 // and the scalar tail on the rest
+
+// what a caster may differ from the exact hit by
+#define DISTANCE_TOLERANCE 0.01   // absolute, in map units
+#define RELATIVE_TOLERANCE 1e-4   // of the distance, for the float stepping along long rays
+#define CORNER_EPSILON 0.05       // hits this close to a grid corner may land on either face
+#define GRAZE_EPSILON 0.01        // rays passing this close to a corner may take either side of it
+
+struct ReferenceHit {
+    double distance;
+    int col;
+    int row;
+    int isVertical;
+    int content;
+    int isAtCorner;
+};
+
+struct CasterHit {
+    const char *caster;
+    float distance;
+    int isVertical;
+    int content;
+};
+
+// xorshift32, the same sequence everywhere for a seed
+static uint32_t nextRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static int randomInt(uint32_t *state, int count) {
+    return nextRandom(state) % count;
+}
+
+// lanes of the 4 ray kernel, then the scalar tail of the batch
+static const char *batchCasterNames[] = {
+        "castRayBatch lane 0", "castRayBatch lane 1", "castRayBatch lane 2", "castRayBatch lane 3",
+        "castRayBatch tail"
+};
+
+static double randomUnit(uint32_t *state) {
+    return nextRandom(state) / 4294967296.0;
+}
+
+// Exact grid walk from (x, y) along angle: the first solid cell past the start cell, cells outside
+// of the map are solid. A ray through a grid corner passes it as if it were a hair to one side of
+// it, first to the next column with isColumnFirst, first to the next row otherwise.
+static void castReference(const struct Map *map, double x, double y, double angle, int isColumnFirst,
+                          struct ReferenceHit *hit) {
+    double dirX = cos(angle);
+    double dirY = sin(angle);
+    int col = (int) floor(x / TILE_SIZE);
+    int row = (int) floor(y / TILE_SIZE);
+    int stepCol = dirX > 0 ? 1 : -1;
+    int stepRow = dirY > 0 ? 1 : -1;
+    double tDeltaX = dirX != 0 ? fabs(TILE_SIZE / dirX) : INFINITY;
+    double tDeltaY = dirY != 0 ? fabs(TILE_SIZE / dirY) : INFINITY;
+    double tMaxX = dirX != 0 ? ((col + (dirX > 0)) * TILE_SIZE - x) / dirX : INFINITY;
+    double tMaxY = dirY != 0 ? ((row + (dirY > 0)) * TILE_SIZE - y) / dirY : INFINITY;
+
+    for (;;) {
+        double t;
+        if (tMaxX < tMaxY || (tMaxX == tMaxY && isColumnFirst)) {
+            t = tMaxX;
+            col += stepCol;
+            tMaxX += tDeltaX;
+            hit->isVertical = TRUE;
+        } else {
+            t = tMaxY;
+            row += stepRow;
+            tMaxY += tDeltaY;
+            hit->isVertical = FALSE;
+        }
+        if (mapIsSolidCell(map, col, row)) {
+            double hitX = x + dirX * t;
+            double hitY = y + dirY * t;
+            double cornerX = fabs(hitX - round(hitX / TILE_SIZE) * TILE_SIZE);
+            double cornerY = fabs(hitY - round(hitY / TILE_SIZE) * TILE_SIZE);
+            hit->distance = t;
+            hit->col = col;
+            hit->row = row;
+            hit->content = mapContentAt(map, col, row);
+            hit->isAtCorner = cornerX < CORNER_EPSILON && cornerY < CORNER_EPSILON;
+            return;
+        }
+    }
+}
+
+static int matchesReference(const struct CasterHit *hit, const struct ReferenceHit *reference, double slack) {
+    double tolerance = DISTANCE_TOLERANCE + RELATIVE_TOLERANCE * reference->distance + slack;
+    if (fabs(hit->distance - reference->distance) > tolerance) {
+        return FALSE;
+    }
+    // the faces meeting at a corner are as good as each other
+    return reference->isAtCorner || (hit->isVertical == reference->isVertical && hit->content == reference->content);
+}
+
+// Whether a point is on a wall, up to a margin: a solid cell is within the margin on both axes.
+static int isNextToWall(const struct Map *map, double x, double y, double margin) {
+    for (int i = 0; i < 4; ++i) {
+        int col = (int) floor((x + (i & 1 ? margin : -margin)) / TILE_SIZE);
+        int row = (int) floor((y + (i & 2 ? margin : -margin)) / TILE_SIZE);
+        if (mapIsSolidCell(map, col, row)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// A caster hit is right when it matches the exact hit of its ray, or of the same ray moved
+// sideways by a rounding error: float intercepts may take a ray grazing a corner past either side.
+// Moving a ray sideways moves its hit along the wall face, the more the more it grazes the face.
+// A ray lined up with several corners may take a different side at each of them, so a hit on a
+// wall between the nearest and the farthest of those hits is right too.
+static int checkHit(const struct Map *map, double x, double y, double angle, const struct CasterHit *hit,
+                    struct ReferenceHit *reference) {
+    double dirX = cos(angle);
+    double dirY = sin(angle);
+    castReference(map, x, y, angle, TRUE, reference);
+    double nearest = reference->distance;
+    double farthest = reference->distance;
+    struct ReferenceHit nearby;
+    for (int side = -1; side <= 1; ++side) {
+        for (int isColumnFirst = FALSE; isColumnFirst <= TRUE; ++isColumnFirst) {
+            castReference(map, x - dirY * side * GRAZE_EPSILON, y + dirX * side * GRAZE_EPSILON, angle, isColumnFirst,
+                          &nearby);
+            double slack = side == 0 ? 0 : GRAZE_EPSILON / fabs(nearby.isVertical ? dirX : dirY);
+            if (matchesReference(hit, &nearby, slack)) {
+                return TRUE;
+            }
+            nearest = nearby.distance < nearest ? nearby.distance : nearest;
+            farthest = nearby.distance > farthest ? nearby.distance : farthest;
+        }
+    }
+    double tolerance = DISTANCE_TOLERANCE + RELATIVE_TOLERANCE * farthest;
+    return hit->distance >= nearest - tolerance && hit->distance <= farthest + tolerance &&
+           isNextToWall(map, x + dirX * hit->distance, y + dirY * hit->distance, GRAZE_EPSILON + tolerance);
+}
+
+static void randomMap(uint32_t *state, int *cells, int *numCols, int *numRows) {
+    *numCols = MIN_MAP_SIZE + randomInt(state, MAX_MAP_SIZE - MIN_MAP_SIZE + 1);
+    *numRows = MIN_MAP_SIZE + randomInt(state, MAX_MAP_SIZE - MIN_MAP_SIZE + 1);
+    int hasBorder = randomInt(state, 2);
+    for (int row = 0; row < *numRows; ++row) {
+        for (int col = 0; col < *numCols; ++col) {
+            int isBorder = row == 0 || col == 0 || row == *numRows - 1 || col == *numCols - 1;
+            int isWall = (hasBorder && isBorder) || randomInt(state, 100) < WALL_PERCENT;
+            // wall textures only, the reference knows nothing of doors
+            cells[row * *numCols + col] = isWall ? 1 + randomInt(state, NUM_TEXTURES) : 0;
+        }
+    }
+}
+
+// Picks a pose in a free cell of the map, returns FALSE when the map has none.
+static int randomPose(uint32_t *state, const struct Map *map, float *x, float *y, float *angle) {
+    int numCells = map->numCols * map->numRows;
+    int cell = randomInt(state, numCells);
+    for (int i = 0; i < numCells && map->cells[cell] != 0; ++i) {
+        cell = (cell + 1) % numCells;
+    }
+    if (map->cells[cell] != 0) {
+        return FALSE;
+    }
+    int col = cell % map->numCols;
+    int row = cell / map->numCols;
+
+    switch (randomInt(state, 4)) {
+        case 0: // anywhere in the cell
+            *x = (col + randomUnit(state)) * TILE_SIZE;
+            *y = (row + randomUnit(state)) * TILE_SIZE;
+            break;
+        case 1: // center
+            *x = (col + 0.5f) * TILE_SIZE;
+            *y = (row + 0.5f) * TILE_SIZE;
+            break;
+        case 2: // on a grid line
+            *x = col * TILE_SIZE;
+            *y = (row + randomUnit(state)) * TILE_SIZE;
+            if (randomInt(state, 2)) {
+                *y = row * TILE_SIZE;
+                *x = (col + randomUnit(state)) * TILE_SIZE;
+            }
+            break;
+        default: // corner
+            *x = col * TILE_SIZE;
+            *y = row * TILE_SIZE;
+            break;
+    }
+
+    switch (randomInt(state, 5)) {
+        case 0:
+            *angle = randomUnit(state) * TWO_PI;
+            break;
+        case 1: // exactly along an axis
+            *angle = randomInt(state, 4) * (PI / 2);
+            break;
+        case 2: // diagonal, through the corners from centers and corners
+            *angle = (2 * randomInt(state, 4) + 1) * (PI / 4);
+            break;
+        case 3: { // at a grid corner
+            float cornerX = randomInt(state, map->numCols + 1) * TILE_SIZE;
+            float cornerY = randomInt(state, map->numRows + 1) * TILE_SIZE;
+            *angle = cornerX == *x && cornerY == *y ? 0 : atan2(cornerY - *y, cornerX - *x);
+            break;
+        }
+        default: // a hair off an axis
+            *angle = randomInt(state, 4) * (PI / 2) + (randomInt(state, 2) ? 1 : -1) * pow(10, -1 - randomInt(state, 6));
+            break;
+    }
+    *angle = normalizeAngle(*angle);
+    return TRUE;
+}
+
+static void reportMismatch(uint32_t mapSeed, float x, float y, float angle, const struct CasterHit *hit,
+                           const struct ReferenceHit *reference) {
+    fprintf(stderr, "map seed %u, pose %.9g %.9g %.9g: %s hit %.6g %s content %d, reference %.6g %s content %d%s\n",
+            mapSeed, x, y, angle, hit->caster, hit->distance, hit->isVertical ? "vertical" : "horizontal",
+            hit->content, reference->distance, reference->isVertical ? "vertical" : "horizontal",
+            reference->content, reference->isAtCorner ? " at a corner" : "");
+}
+
+int main(int argc, char *argv[]) {
+    int numMaps = DEFAULT_NUM_MAPS;
+    int numPoses = DEFAULT_NUM_POSES;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            numMaps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            numPoses = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: raycheck [-n maps] [-p poses] [-s seed]\n");
+            return 1;
+        }
+    }
+
+    int *cells = malloc(sizeof(int) * MAX_MAP_SIZE * MAX_MAP_SIZE);
+    if (!cells) {
+        return 1;
+    }
+    long numRays = 0;
+    long numMismatches = 0;
+    for (int m = 0; m < numMaps; ++m) {
+        // xorshift never leaves 0
+        uint32_t mapSeed = seed + m ? seed + m : 1;
+        uint32_t state = mapSeed;
+        int numCols, numRows;
+        randomMap(&state, cells, &numCols, &numRows);
+        struct World *world = createWorld(cells, numCols, numRows);
+        struct Raycaster *rc = world ? createRaycaster(world, 1, 1) : NULL;
+        if (!rc) {
+            fprintf(stderr, "Error creating the raycaster\n");
+            return 1;
+        }
+
+        // the poses go to castRayBatch() in groups of random size, castRay() takes them one by one
+        int numCast = 0;
+        int hasPoses = TRUE;
+        while (hasPoses && numCast < numPoses) {
+            struct RayQuery queries[MAX_BATCH_SIZE];
+            struct RayHit batchHits[MAX_BATCH_SIZE];
+            float angles[MAX_BATCH_SIZE];
+            int batchSize = MIN_BATCH_SIZE + randomInt(&state, MAX_BATCH_SIZE - MIN_BATCH_SIZE + 1);
+            int numQueries = 0;
+            while (numQueries < batchSize && numCast < numPoses) {
+                float x, y, angle;
+                if (!randomPose(&state, &world->map, &x, &y, &angle)) {
+                    hasPoses = FALSE;
+                    break;
+                }
+                queries[numQueries] = (struct RayQuery) {x, y, cos(angle), sin(angle), INFINITY};
+                angles[numQueries++] = angle;
+                ++numCast;
+            }
+            castRayBatch(&world->map, queries, batchHits, numQueries);
+
+            for (int q = 0; q < numQueries; ++q) {
+                float x = queries[q].originX;
+                float y = queries[q].originY;
+                float angle = angles[q];
+                rc->camera.x = x;
+                rc->camera.y = y;
+                rc->camera.angle = angle;
+                castRay(rc, angle, 0);
+                int lane = q < numQueries / 4 * 4 ? q % 4 : 4;
+                struct CasterHit hits[2] = {
+                        {"castRay", rc->rays[0].distance, rc->rays[0].wasHitVertical, rc->rays[0].wallHitContent},
+                        {batchCasterNames[lane], batchHits[q].distance, batchHits[q].isVertical,
+                         batchHits[q].content}
+                };
+
+                for (int h = 0; h < 2; ++h) {
+                    struct ReferenceHit reference;
+                    ++numRays;
+                    if (!checkHit(&world->map, x, y, angle, &hits[h], &reference)) {
+                        if (++numMismatches <= MAX_REPORTED_MISMATCHES) {
+                            reportMismatch(mapSeed, x, y, angle, &hits[h], &reference);
+                        }
+                    }
+                }
+            }
+        }
+        destroyRaycaster(rc);
+        destroyWorld(world);
+    }
+    free(cells);
+
+    printf("%d maps, %ld rays, %ld mismatches\n", numMaps, numRays, numMismatches);
+    return numMismatches > 0;
+}
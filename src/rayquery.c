@@ -0,0 +1,286 @@
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "raycaster.h"
+#include "rayquery.h"
+
+// queries handed to a thread at a time
+#define RAY_BATCH_CHUNK 256
+
+// Grid crossings closer than this, relative to their distance, are the same crossing through a cell
+// corner: the float rounding of the two walks must not decide which cell the ray enters there.
+#define CORNER_TIE_EPSILON 1e-5f
+
+struct RaySetup {
+    float dirX;
+    float dirY;
+    int col;
+    int row;
+    int stepCol;
+    int stepRow;
+    float tMaxX;
+    float tMaxY;
+    float tDeltaX;
+    float tDeltaY;
+};
+
+static void writeMiss(const struct RayQuery *query, struct RayHit *hit) {
+    hit->hasHit = FALSE;
+    hit->distance = query->maxDistance;
+    hit->cellX = -1;
+    hit->cellY = -1;
+    hit->isVertical = FALSE;
+    hit->textureU = 0;
+    hit->content = 0;
+}
+
+// returns FALSE for a degenerate query, with a zero direction
+static int setupRay(const struct RayQuery *query, struct RaySetup *setup) {
+    float length = sqrt(query->dirX * query->dirX + query->dirY * query->dirY);
+    if (length == 0) {
+        return FALSE;
+    }
+    float dirX = query->dirX / length;
+    float dirY = query->dirY / length;
+    int col = (int) floor(query->originX / TILE_SIZE);
+    int row = (int) floor(query->originY / TILE_SIZE);
+
+    setup->dirX = dirX;
+    setup->dirY = dirY;
+    setup->col = col;
+    setup->row = row;
+    setup->stepCol = dirX > 0 ? 1 : -1;
+    setup->stepRow = dirY > 0 ? 1 : -1;
+    // distance along the ray to the next vertical and horizontal grid line, and between two of them
+    setup->tDeltaX = dirX != 0 ? fabs(TILE_SIZE / dirX) : INFINITY;
+    setup->tDeltaY = dirY != 0 ? fabs(TILE_SIZE / dirY) : INFINITY;
+    setup->tMaxX = dirX != 0 ? ((col + (dirX > 0)) * TILE_SIZE - query->originX) / dirX : INFINITY;
+    setup->tMaxY = dirY != 0 ? ((row + (dirY > 0)) * TILE_SIZE - query->originY) / dirY : INFINITY;
+    return TRUE;
+}
+
+// Resolves a ray that entered the solid cell (col, row) at distance t.
+// Returns FALSE when the ray goes on, past the open part of a door.
+static int resolveHit(const struct Map *map, const struct RayQuery *query, float dirX, float dirY, int col, int row,
+                      float t, int isVertical, struct RayHit *hit) {
+    int content = mapContentAt(map, col, row);
+    float hitX = query->originX + dirX * t;
+    float hitY = query->originY + dirY * t;
+    float textureU;
+
+    if (content == DOOR_CELL) {
+        if (!mapDoorHit(map, col, row, hitX, hitY, dirX, dirY, &hitX, &hitY)) {
+            return FALSE;
+        }
+        t = distanceBetweenPoints(query->originX, query->originY, hitX, hitY);
+        isVertical = map->doors[findDoor(map, col, row)].isVertical;
+        textureU = (float) mapDoorTextureOffset(map, hitX, hitY) / TILE_SIZE;
+    } else {
+        textureU = (isVertical ? hitY : hitX) / TILE_SIZE;
+        textureU -= floor(textureU);
+    }
+
+    if (t > query->maxDistance) {
+        writeMiss(query, hit);
+        return TRUE;
+    }
+    hit->hasHit = TRUE;
+    hit->distance = t;
+    hit->cellX = col;
+    hit->cellY = row;
+    hit->isVertical = isVertical;
+    hit->textureU = textureU;
+    hit->content = content;
+    return TRUE;
+}
+
+// Through a cell corner the ray touches both cells next to it, so it steps into a solid one when
+// there is one: otherwise rounding could slip the ray through corners between walls on either side
+// of an exact diagonal. Returns whether the step goes along x.
+static int stepThroughCorner(const struct Map *map, const struct RaySetup *ray, int isStepX) {
+    if (mapIsSolidCell(map, ray->col + ray->stepCol, ray->row)) {
+        return TRUE;
+    }
+    if (mapIsSolidCell(map, ray->col, ray->row + ray->stepRow)) {
+        return FALSE;
+    }
+    return isStepX;
+}
+
+static void castQuery(const struct Map *map, const struct RayQuery *query, struct RayHit *hit) {
+    struct RaySetup ray;
+    if (!setupRay(query, &ray)) {
+        writeMiss(query, hit);
+        return;
+    }
+
+    float t = 0;
+    int isVertical = FALSE;
+    for (;;) {
+        // cells outside of the map are solid, so the loop always ends
+        if (mapIsSolidCell(map, ray.col, ray.row) &&
+            resolveHit(map, query, ray.dirX, ray.dirY, ray.col, ray.row, t, isVertical, hit)) {
+            return;
+        }
+        int isStepX = ray.tMaxX < ray.tMaxY;
+        if (fabsf(ray.tMaxX - ray.tMaxY) <= CORNER_TIE_EPSILON * fminf(ray.tMaxX, ray.tMaxY)) {
+            isStepX = stepThroughCorner(map, &ray, isStepX);
+        }
+        if (isStepX) {
+            t = ray.tMaxX;
+            ray.col += ray.stepCol;
+            ray.tMaxX += ray.tDeltaX;
+            isVertical = TRUE;
+        } else {
+            t = ray.tMaxY;
+            ray.row += ray.stepRow;
+            ray.tMaxY += ray.tDeltaY;
+            isVertical = FALSE;
+        }
+        if (t > query->maxDistance) {
+            writeMiss(query, hit);
+            return;
+        }
+    }
+}
+
+#ifdef __SSE2__
+// Four rays walk the grid in lockstep, the cell lookups stay scalar.
+// The float operations match castQuery(), so both give the same results.
+static void castQuery4(const struct Map *map, const struct RayQuery *queries, struct RayHit *hits) {
+    // lanes of zero length queries are not set up, but still loaded into the vectors below
+    struct RaySetup rays[4] = {{0}};
+    float dirX[4] __attribute__((aligned(16)));
+    float dirY[4] __attribute__((aligned(16)));
+    int activeMask = 0;
+    for (int lane = 0; lane < 4; ++lane) {
+        if (!setupRay(&queries[lane], &rays[lane])) {
+            writeMiss(&queries[lane], &hits[lane]);
+        } else if (mapIsSolidCell(map, rays[lane].col, rays[lane].row)) {
+            // rays starting in a wall or a door cell are rare, leave them to the scalar path
+            castQuery(map, &queries[lane], &hits[lane]);
+        } else {
+            activeMask |= 1 << lane;
+        }
+        dirX[lane] = rays[lane].dirX;
+        dirY[lane] = rays[lane].dirY;
+    }
+    if (!activeMask) {
+        return;
+    }
+
+    __m128 tMaxX = _mm_setr_ps(rays[0].tMaxX, rays[1].tMaxX, rays[2].tMaxX, rays[3].tMaxX);
+    __m128 tMaxY = _mm_setr_ps(rays[0].tMaxY, rays[1].tMaxY, rays[2].tMaxY, rays[3].tMaxY);
+    __m128 tDeltaX = _mm_setr_ps(rays[0].tDeltaX, rays[1].tDeltaX, rays[2].tDeltaX, rays[3].tDeltaX);
+    __m128 tDeltaY = _mm_setr_ps(rays[0].tDeltaY, rays[1].tDeltaY, rays[2].tDeltaY, rays[3].tDeltaY);
+    __m128 maxDistance = _mm_setr_ps(queries[0].maxDistance, queries[1].maxDistance, queries[2].maxDistance,
+                                     queries[3].maxDistance);
+    __m128i col = _mm_setr_epi32(rays[0].col, rays[1].col, rays[2].col, rays[3].col);
+    __m128i row = _mm_setr_epi32(rays[0].row, rays[1].row, rays[2].row, rays[3].row);
+    __m128i stepCol = _mm_setr_epi32(rays[0].stepCol, rays[1].stepCol, rays[2].stepCol, rays[3].stepCol);
+    __m128i stepRow = _mm_setr_epi32(rays[0].stepRow, rays[1].stepRow, rays[2].stepRow, rays[3].stepRow);
+
+    int cols[4] __attribute__((aligned(16)));
+    int rows[4] __attribute__((aligned(16)));
+    float t[4] __attribute__((aligned(16)));
+    int stepsX[4] __attribute__((aligned(16)));
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 tieEpsilon = _mm_set1_ps(CORNER_TIE_EPSILON);
+
+    while (activeMask) {
+        __m128 isStepX = _mm_cmplt_ps(tMaxX, tMaxY);
+        __m128 tieDistance = _mm_mul_ps(tieEpsilon, _mm_min_ps(tMaxX, tMaxY));
+        __m128 isTie = _mm_cmple_ps(_mm_and_ps(_mm_sub_ps(tMaxX, tMaxY), absMask), tieDistance);
+        int tieMask = _mm_movemask_ps(isTie) & activeMask;
+        if (tieMask) {
+            // rare, the lanes crossing a corner pick their step like castQuery()
+            _mm_store_si128((__m128i *) cols, col);
+            _mm_store_si128((__m128i *) rows, row);
+            _mm_store_si128((__m128i *) stepsX, _mm_castps_si128(isStepX));
+            for (int lane = 0; lane < 4; ++lane) {
+                if (tieMask & (1 << lane)) {
+                    struct RaySetup ray = rays[lane];
+                    ray.col = cols[lane];
+                    ray.row = rows[lane];
+                    stepsX[lane] = stepThroughCorner(map, &ray, stepsX[lane] != 0) ? -1 : 0;
+                }
+            }
+            isStepX = _mm_castsi128_ps(_mm_load_si128((const __m128i *) stepsX));
+        }
+        __m128i isStepXi = _mm_castps_si128(isStepX);
+        __m128 distance = _mm_or_ps(_mm_and_ps(isStepX, tMaxX), _mm_andnot_ps(isStepX, tMaxY));
+        col = _mm_add_epi32(col, _mm_and_si128(isStepXi, stepCol));
+        row = _mm_add_epi32(row, _mm_andnot_si128(isStepXi, stepRow));
+        tMaxX = _mm_add_ps(tMaxX, _mm_and_ps(isStepX, tDeltaX));
+        tMaxY = _mm_add_ps(tMaxY, _mm_andnot_ps(isStepX, tDeltaY));
+
+        int missMask = _mm_movemask_ps(_mm_cmpgt_ps(distance, maxDistance)) & activeMask;
+        int verticalMask = _mm_movemask_ps(isStepX);
+        _mm_store_si128((__m128i *) cols, col);
+        _mm_store_si128((__m128i *) rows, row);
+        _mm_store_ps(t, distance);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            int laneBit = 1 << lane;
+            if (!(activeMask & laneBit)) {
+                continue;
+            }
+            if (missMask & laneBit) {
+                writeMiss(&queries[lane], &hits[lane]);
+                activeMask &= ~laneBit;
+            } else if (mapIsSolidCell(map, cols[lane], rows[lane])) {
+                if (mapContentAt(map, cols[lane], rows[lane]) == DOOR_CELL) {
+                    // the ray may go on through the door, finish it on the scalar path
+                    castQuery(map, &queries[lane], &hits[lane]);
+                } else {
+                    resolveHit(map, &queries[lane], dirX[lane], dirY[lane], cols[lane], rows[lane], t[lane],
+                               (verticalMask & laneBit) != 0, &hits[lane]);
+                }
+                activeMask &= ~laneBit;
+            }
+        }
+    }
+}
+#endif
+
+void castRayBatch(const struct Map *map, const struct RayQuery *queries, struct RayHit *hits, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= count; i += 4) {
+        castQuery4(map, &queries[i], &hits[i]);
+    }
+#endif
+    for (; i < count; ++i) {
+        castQuery(map, &queries[i], &hits[i]);
+    }
+}
+
+struct RayBatchJob {
+    const struct Map *map;
+    const struct RayQuery *queries;
+    struct RayHit *hits;
+    int count;
+};
+
+static void runRayBatchJob(void *context, int jobIndex) {
+    const struct RayBatchJob *batch = context;
+    int first = jobIndex * RAY_BATCH_CHUNK;
+    int count = batch->count - first < RAY_BATCH_CHUNK ? batch->count - first : RAY_BATCH_CHUNK;
+    castRayBatch(batch->map, &batch->queries[first], &batch->hits[first], count);
+}
+
+void castRayBatchParallel(struct ThreadPool *pool, const struct Map *map, const struct RayQuery *queries,
+                          struct RayHit *hits, int count) {
+    struct RayBatchJob batch = {map, queries, hits, count};
+    threadPoolRun(pool, runRayBatchJob, &batch, (count + RAY_BATCH_CHUNK - 1) / RAY_BATCH_CHUNK);
+}
+
+int hasLineOfSight(const struct Map *map, float x0, float y0, float x1, float y1) {
+    struct RayQuery query = {x0, y0, x1 - x0, y1 - y0, distanceBetweenPoints(x0, y0, x1, y1)};
+    struct RayHit hit;
+    castQuery(map, &query, &hit);
+    return !hit.hasHit;
+}
@@ -0,0 +1,35 @@
+#ifndef RAYCASTING_RAYQUERY_H
+#define RAYCASTING_RAYQUERY_H
+
+#include "map.h"
+#include "threadpool.h"
+
+// Ray queries for line of sight and sensor simulation, independent of any camera.
+struct RayQuery {
+    float originX;
+    float originY;
+    float dirX; // does not need to be normalized
+    float dirY;
+    float maxDistance;
+};
+
+struct RayHit {
+    int hasHit;       // FALSE when nothing was hit within maxDistance
+    float distance;   // maxDistance on a miss
+    int cellX;        // cell that was hit, -1 on a miss
+    int cellY;
+    int isVertical;   // the hit face lies on a vertical grid line (or is a vertical door panel)
+    float textureU;   // hit position along the face, in [0, 1)
+    int content;      // map content of the hit cell, 0 on a miss
+};
+
+// Grid traversal of every query against the solid cells of the map, 4 rays at a time with SSE2.
+void castRayBatch(const struct Map *map, const struct RayQuery *queries, struct RayHit *hits, int count);
+
+// Same as castRayBatch(), split in chunks across the threads of the pool.
+void castRayBatchParallel(struct ThreadPool *pool, const struct Map *map, const struct RayQuery *queries,
+                          struct RayHit *hits, int count);
+
+int hasLineOfSight(const struct Map *map, float x0, float y0, float x1, float y1);
+
+#endif //RAYCASTING_RAYQUERY_H
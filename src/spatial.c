@@ -0,0 +1,189 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "constants.h"
+#include "spatial.h"
+
+int initSpatialGrid(struct SpatialGrid *grid, int numCols, int numRows, int maxEntities) {
+    int numCells = numCols * numRows;
+    grid->numCols = numCols;
+    grid->numRows = numRows;
+    grid->maxEntities = maxEntities;
+    grid->cellHeads = malloc(sizeof(int) * numCells);
+    grid->next = malloc(sizeof(int) * maxEntities);
+    grid->prev = malloc(sizeof(int) * maxEntities);
+    grid->entityCells = malloc(sizeof(int) * maxEntities);
+
+    if (!grid->cellHeads || !grid->next || !grid->prev || !grid->entityCells) {
+        freeSpatialGrid(grid);
+        return FALSE;
+    }
+    for (int i = 0; i < numCells; ++i) {
+        grid->cellHeads[i] = -1;
+    }
+    for (int i = 0; i < maxEntities; ++i) {
+        grid->entityCells[i] = -1;
+    }
+    return TRUE;
+}
+
+void freeSpatialGrid(struct SpatialGrid *grid) {
+    free(grid->cellHeads);
+    free(grid->next);
+    free(grid->prev);
+    free(grid->entityCells);
+    grid->cellHeads = NULL;
+    grid->next = NULL;
+    grid->prev = NULL;
+    grid->entityCells = NULL;
+}
+
+int initSpatialQuery(struct SpatialQuery *query, int numCols, int numRows) {
+    query->numCols = numCols;
+    query->numRows = numRows;
+    query->cellMarks = calloc(numCols * numRows, sizeof(unsigned));
+    query->markedCells = malloc(sizeof(int) * numCols * numRows);
+    query->stamp = 0;
+    query->numMarkedCells = 0;
+    if (!query->cellMarks || !query->markedCells) {
+        freeSpatialQuery(query);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void freeSpatialQuery(struct SpatialQuery *query) {
+    free(query->cellMarks);
+    free(query->markedCells);
+    query->cellMarks = NULL;
+    query->markedCells = NULL;
+}
+
+static int clampIndex(int index, int count) {
+    return index < 0 ? 0 : (index >= count ? count - 1 : index);
+}
+
+static int cellAt(const struct SpatialGrid *grid, float x, float y) {
+    int col = clampIndex((int) floor(x / TILE_SIZE), grid->numCols);
+    int row = clampIndex((int) floor(y / TILE_SIZE), grid->numRows);
+    return row * grid->numCols + col;
+}
+
+static void linkEntity(struct SpatialGrid *grid, int entity, int cell) {
+    int head = grid->cellHeads[cell];
+    grid->next[entity] = head;
+    grid->prev[entity] = -1;
+    if (head >= 0) {
+        grid->prev[head] = entity;
+    }
+    grid->cellHeads[cell] = entity;
+    grid->entityCells[entity] = cell;
+}
+
+static void unlinkEntity(struct SpatialGrid *grid, int entity) {
+    int cell = grid->entityCells[entity];
+    int next = grid->next[entity];
+    int prev = grid->prev[entity];
+    if (prev >= 0) {
+        grid->next[prev] = next;
+    } else {
+        grid->cellHeads[cell] = next;
+    }
+    if (next >= 0) {
+        grid->prev[next] = prev;
+    }
+    grid->entityCells[entity] = -1;
+}
+
+void spatialGridInsert(struct SpatialGrid *grid, int entity, float x, float y) {
+    if (grid->entityCells[entity] >= 0) {
+        unlinkEntity(grid, entity);
+    }
+    linkEntity(grid, entity, cellAt(grid, x, y));
+}
+
+void spatialGridMove(struct SpatialGrid *grid, int entity, float x, float y) {
+    int cell = cellAt(grid, x, y);
+    if (grid->entityCells[entity] == cell) {
+        return;
+    }
+    if (grid->entityCells[entity] >= 0) {
+        unlinkEntity(grid, entity);
+    }
+    linkEntity(grid, entity, cell);
+}
+
+void spatialGridRemove(struct SpatialGrid *grid, int entity) {
+    if (grid->entityCells[entity] >= 0) {
+        unlinkEntity(grid, entity);
+    }
+}
+
+void spatialQueryBegin(struct SpatialQuery *query) {
+    query->numMarkedCells = 0;
+    query->stamp++;
+    if (query->stamp == 0) {
+        // the stamp wrapped around, old marks could alias the new stamp
+        for (int i = 0; i < query->numCols * query->numRows; ++i) {
+            query->cellMarks[i] = 0;
+        }
+        query->stamp = 1;
+    }
+}
+
+void spatialQueryMarkCell(struct SpatialQuery *query, int col, int row) {
+    if (col < 0 || col >= query->numCols || row < 0 || row >= query->numRows) {
+        return;
+    }
+    int cell = row * query->numCols + col;
+    if (query->cellMarks[cell] != query->stamp) {
+        query->cellMarks[cell] = query->stamp;
+        query->markedCells[query->numMarkedCells++] = cell;
+    }
+}
+
+void spatialQueryMarkSegment(struct SpatialQuery *query, float x0, float y0, float x1, float y1) {
+    int col = (int) floor(x0 / TILE_SIZE);
+    int row = (int) floor(y0 / TILE_SIZE);
+    int lastCol = (int) floor(x1 / TILE_SIZE);
+    int lastRow = (int) floor(y1 / TILE_SIZE);
+
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    int stepCol = dx > 0 ? 1 : -1;
+    int stepRow = dy > 0 ? 1 : -1;
+
+    // distance along the segment, in segment lengths, to the next vertical and horizontal grid line
+    float tDeltaX = dx != 0 ? fabs(TILE_SIZE / dx) : INFINITY;
+    float tDeltaY = dy != 0 ? fabs(TILE_SIZE / dy) : INFINITY;
+    float tMaxX = dx != 0 ? ((col + (dx > 0)) * TILE_SIZE - x0) / dx : INFINITY;
+    float tMaxY = dy != 0 ? ((row + (dy > 0)) * TILE_SIZE - y0) / dy : INFINITY;
+
+    // the traversal never takes more steps than the Manhattan distance between both end cells
+    int numSteps = abs(lastCol - col) + abs(lastRow - row);
+    spatialQueryMarkCell(query, col, row);
+    for (int i = 0; i < numSteps; ++i) {
+        if (tMaxX < tMaxY) {
+            col += stepCol;
+            tMaxX += tDeltaX;
+        } else {
+            row += stepRow;
+            tMaxY += tDeltaY;
+        }
+        spatialQueryMarkCell(query, col, row);
+    }
+}
+
+int spatialGridCollect(const struct SpatialGrid *grid, const struct SpatialQuery *query, int *entities,
+                       int maxCount) {
+    int count = 0;
+    for (int i = 0; i < query->numMarkedCells; ++i) {
+        for (int entity = grid->cellHeads[query->markedCells[i]]; entity >= 0; entity = grid->next[entity]) {
+            if (count == maxCount) {
+                return count;
+            }
+            entities[count++] = entity;
+        }
+    }
+    return count;
+}
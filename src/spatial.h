@@ -0,0 +1,55 @@
+#ifndef RAYCASTING_SPATIAL_H
+#define RAYCASTING_SPATIAL_H
+
+// Uniform grid index of entities, aligned with the TILE_SIZE cells of the map.
+// Every cell keeps an intrusive doubly linked list of the entities inside it,
+// so insert, move and remove are O(1).
+struct SpatialGrid {
+    int numCols;
+    int numRows;
+    int maxEntities;
+    int *cellHeads;    // first entity of every cell, -1 when empty
+    int *next;         // per entity links inside its cell
+    int *prev;
+    int *entityCells;  // cell of every entity, -1 when not inserted
+};
+
+// Scratch of the region queries of one caller, so several callers can query the same grid
+// at the same time. Sized for a grid of numCols by numRows cells.
+struct SpatialQuery {
+    int numCols;
+    int numRows;
+    unsigned *cellMarks;  // query stamp of every cell, to visit each cell once
+    unsigned stamp;
+    int *markedCells;  // cells marked by the current query
+    int numMarkedCells;
+};
+
+int initSpatialGrid(struct SpatialGrid *grid, int numCols, int numRows, int maxEntities);
+
+void freeSpatialGrid(struct SpatialGrid *grid);
+
+void spatialGridInsert(struct SpatialGrid *grid, int entity, float x, float y);
+
+void spatialGridMove(struct SpatialGrid *grid, int entity, float x, float y);
+
+void spatialGridRemove(struct SpatialGrid *grid, int entity);
+
+int initSpatialQuery(struct SpatialQuery *query, int numCols, int numRows);
+
+void freeSpatialQuery(struct SpatialQuery *query);
+
+// Region queries are built in two steps: mark the cells of interest, then collect
+// the entities inside them. Every cell is reported once per query.
+void spatialQueryBegin(struct SpatialQuery *query);
+
+void spatialQueryMarkCell(struct SpatialQuery *query, int col, int row);
+
+// marks every cell crossed by the segment, in the same grid traversal order as a ray
+void spatialQueryMarkSegment(struct SpatialQuery *query, float x0, float y0, float x1, float y1);
+
+// returns the number of entities of the marked cells written to entities, at most maxCount
+int spatialGridCollect(const struct SpatialGrid *grid, const struct SpatialQuery *query, int *entities,
+                       int maxCount);
+
+#endif //RAYCASTING_SPATIAL_H
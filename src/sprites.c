@@ -0,0 +1,288 @@
+#include <math.h>
+#include <string.h>
+
+#include "sprites.h"
+#include "raycaster.h"
+
+// sprites closer than this are clipped by the near plane
+#define SPRITE_NEAR_PLANE 1.0f
+
+int addSprite(struct SpriteList *list, float x, float y, int texture, int isDynamic) {
+    if (list->numSprites >= MAX_SPRITES) {
+        return -1;
+    }
+    struct Sprite *sprite = &list->sprites[list->numSprites];
+    sprite->x = x;
+    sprite->y = y;
+    sprite->velocityX = 0;
+    sprite->velocityY = 0;
+    sprite->texture = texture;
+    sprite->isDynamic = isDynamic;
+    return list->numSprites++;
+}
+
+int removeSprite(struct SpriteList *list, int index) {
+    // sprites are unordered, so move the last one into the hole
+    int last = list->numSprites - 1;
+    list->sprites[index] = list->sprites[last];
+    list->numSprites--;
+    return last;
+}
+
+static uint32_t depthSortKey(float depth) {
+    // depth is always positive here, so its IEEE bits compare like unsigned integers;
+    // inverting them makes an ascending sort go from far to near
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return ~bits;
+}
+
+// LSD radix sort, 4 passes of 8 bits. The result ends in the original array.
+static void radixSortSprites(struct VisibleSprite *items, struct VisibleSprite *scratch, int count) {
+    if (count < 2) {
+        return;
+    }
+    int histogram[4][256];
+    memset(histogram, 0, sizeof(histogram));
+
+    for (int i = 0; i < count; ++i) {
+        uint32_t key = items[i].sortKey;
+        histogram[0][key & 0xFF]++;
+        histogram[1][(key >> 8) & 0xFF]++;
+        histogram[2][(key >> 16) & 0xFF]++;
+        histogram[3][key >> 24]++;
+    }
+
+    struct VisibleSprite *src = items;
+    struct VisibleSprite *dst = scratch;
+    for (int pass = 0; pass < 4; ++pass) {
+        int shift = pass * 8;
+        // a pass where every key shares the same byte would only copy the data
+        if (histogram[pass][(src[0].sortKey >> shift) & 0xFF] == count) {
+            continue;
+        }
+        int offset = 0;
+        for (int b = 0; b < 256; ++b) {
+            int n = histogram[pass][b];
+            histogram[pass][b] = offset;
+            offset += n;
+        }
+        for (int i = 0; i < count; ++i) {
+            dst[histogram[pass][(src[i].sortKey >> shift) & 0xFF]++] = src[i];
+        }
+        struct VisibleSprite *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != items) {
+        memcpy(items, src, sizeof(struct VisibleSprite) * count);
+    }
+}
+
+static void drawSprite(struct Raycaster *rc, const struct VisibleSprite *visible, const uint32_t *texture,
+                       int firstColumn, int lastColumn) {
+    int width = rc->width;
+    int height = rc->height;
+    int size = visible->size;
+    int left = visible->screenX - size / 2;
+    int top = (height / 2) - (size / 2);
+
+    int firstX = left < firstColumn ? firstColumn : left;
+    int lastX = left + size > lastColumn ? lastColumn : left + size;
+    int firstY = top < 0 ? 0 : top;
+    int lastY = top + size > height ? height : top + size;
+
+    // 16.16 fixed point texture steps, so the inner loop has no division
+    int textureWidth = rc->world->textureWidth;
+    int textureStepX = (textureWidth << 16) / size;
+    int textureStepY = (rc->world->textureHeight << 16) / size;
+    const struct LightShade *shade = &rc->world->shades[lightLevelAt(visible->depth, FALSE)];
+
+    for (int x = firstX; x < lastX; ++x) {
+        if (visible->depth >= rc->zBuffer[x]) {
+            continue;
+        }
+        const uint32_t *textureColumn = texture + (((x - left) * textureStepX) >> 16);
+        int textureY = (firstY - top) * textureStepY;
+        uint32_t *pixel = rc->colorBuffer + width * firstY + x;
+        for (int y = firstY; y < lastY; ++y) {
+            uint32_t texelColor = textureColumn[textureWidth * (textureY >> 16)];
+            // fully transparent texels are skipped
+            if (texelColor & 0xFF000000) {
+                *pixel = shadeColor(texelColor, shade);
+            }
+            textureY += textureStepY;
+            pixel += width;
+        }
+    }
+}
+
+// drawSprite() for the index buffer, dimmed with depth through the colormap
+static void drawSpriteIndexed(struct Raycaster *rc, const struct VisibleSprite *visible, const uint8_t *texture,
+                              int firstColumn, int lastColumn) {
+    int width = rc->width;
+    int height = rc->height;
+    int size = visible->size;
+    int left = visible->screenX - size / 2;
+    int top = (height / 2) - (size / 2);
+
+    int firstX = left < firstColumn ? firstColumn : left;
+    int lastX = left + size > lastColumn ? lastColumn : left + size;
+    int firstY = top < 0 ? 0 : top;
+    int lastY = top + size > height ? height : top + size;
+
+    int textureWidth = rc->world->textureWidth;
+    int textureStepX = (textureWidth << 16) / size;
+    int textureStepY = (rc->world->textureHeight << 16) / size;
+    const uint8_t *colormap = rc->world->palette.colormap[lightLevelAt(visible->depth, FALSE)];
+
+    for (int x = firstX; x < lastX; ++x) {
+        if (visible->depth >= rc->zBuffer[x]) {
+            continue;
+        }
+        const uint8_t *textureColumn = texture + (((x - left) * textureStepX) >> 16);
+        int textureY = (firstY - top) * textureStepY;
+        uint8_t *pixel = rc->indexBuffer + width * firstY + x;
+        for (int y = firstY; y < lastY; ++y) {
+            uint8_t texel = textureColumn[textureWidth * (textureY >> 16)];
+            if (texel != TRANSPARENT_INDEX) {
+                *pixel = colormap[texel];
+            }
+            textureY += textureStepY;
+            pixel += width;
+        }
+    }
+}
+
+int findVisibleSprites(struct Raycaster *rc) {
+    struct World *world = rc->world;
+    struct SpatialQuery *query = &rc->spriteQuery;
+    const struct Map *map = &world->map;
+
+    spatialQueryBegin(query);
+    int cameraCol = (int) floor(rc->camera.x / TILE_SIZE);
+    int cameraRow = (int) floor(rc->camera.y / TILE_SIZE);
+    int cameraCell = cameraRow * map->numCols + cameraCol;
+    int isInside = cameraCol >= 0 && cameraCol < map->numCols && cameraRow >= 0 && cameraRow < map->numRows;
+    if (world->hasPvs && isInside && pvsIsComplete(&world->pvs, cameraCell)) {
+        // every sprite that can show is in the PVS of the camera cell, keep the cells that reach into
+        // the view cone, widened by a column for the snapped angles of incremental casting
+        float cosAngle = cos(rc->camera.angle);
+        float sinAngle = sin(rc->camera.angle);
+        float halfFov = FOV_ANGLE / 2 + FOV_ANGLE / rc->width;
+        float tanHalfFov = tan(halfFov);
+        float cosHalfFov = cos(halfFov);
+        float cellReach = TILE_SIZE * 0.70710678f + SPRITE_REACH;
+        int numCells = pvsVisibleCells(&world->pvs, cameraCell, rc->pvsCells, map->numCols * map->numRows);
+        for (int i = 0; i < numCells; ++i) {
+            int col = rc->pvsCells[i] % map->numCols;
+            int row = rc->pvsCells[i] / map->numCols;
+            float dx = (col + 0.5f) * TILE_SIZE - rc->camera.x;
+            float dy = (row + 0.5f) * TILE_SIZE - rc->camera.y;
+            float depth = dx * cosAngle + dy * sinAngle;
+            float side = dy * cosAngle - dx * sinAngle;
+            // distance from the cell center to the edge of the cone on its side, the whole cone is
+            // on the other side of that edge
+            if ((fabs(side) - depth * tanHalfFov) * cosHalfFov > cellReach) {
+                continue;
+            }
+            spatialQueryMarkCell(query, col, row);
+        }
+    } else {
+        // no set bounds the view, or it misses the cells behind a just opened wall:
+        // the cells crossed by the rays are visible, sprites between two rays can be missed
+        for (int i = 0; i < rc->width; ++i) {
+            spatialQueryMarkSegment(query, rc->camera.x, rc->camera.y, rc->rays[i].wallHitX, rc->rays[i].wallHitY);
+        }
+    }
+    return spatialGridCollect(&world->spriteGrid, query, rc->visibleSpriteIds, MAX_SPRITES);
+}
+
+int prepareSprites(struct Raycaster *rc, const int *candidates, int numCandidates) {
+    const struct SpriteList *list = &rc->world->sprites;
+    struct VisibleSprite *visibleSprites = rc->visibleSprites;
+    float cameraX = rc->camera.x;
+    float cameraY = rc->camera.y;
+    float cosAngle = cos(rc->camera.angle);
+    float sinAngle = sin(rc->camera.angle);
+    float tanHalfFov = tan(FOV_ANGLE / 2);
+    float distanceProjPlane = (rc->width / 2) / tanHalfFov;
+    float anglePerColumn = FOV_ANGLE / rc->width;
+
+    // transform and cull
+    int numVisible = 0;
+    for (int c = 0; c < numCandidates; ++c) {
+        int i = candidates[c];
+        const struct Sprite *sprite = &list->sprites[i];
+        float dx = sprite->x - cameraX;
+        float dy = sprite->y - cameraY;
+
+        // depth along the view direction and offset across it
+        float depth = dx * cosAngle + dy * sinAngle;
+        if (depth < SPRITE_NEAR_PLANE) {
+            continue;
+        }
+        float side = dy * cosAngle - dx * sinAngle;
+        // cheap conservative FOV test before the atan2
+        if (fabs(side) - TILE_SIZE / 2 > depth * tanHalfFov) {
+            continue;
+        }
+
+        int size = (TILE_SIZE / depth) * distanceProjPlane;
+        if (size <= 0) {
+            continue;
+        }
+        // columns are spaced evenly in angle, exactly like the rays
+        int screenX = (atan2(side, depth) + FOV_ANGLE / 2) / anglePerColumn;
+        if (screenX + size / 2 < 0 || screenX - size / 2 >= rc->width) {
+            continue;
+        }
+
+        struct VisibleSprite *visible = &visibleSprites[numVisible++];
+        visible->sortKey = depthSortKey(depth);
+        visible->spriteIndex = i;
+        visible->depth = depth;
+        visible->screenX = screenX;
+        visible->size = size;
+    }
+
+    // the sort scratch comes from the arena of the calling thread, a pool worker in renderViews();
+    // the frame arena has room for a full sprite list too, for threads without an arena
+    struct Arena *scratch = threadArena();
+    size_t scratchMark = scratch ? arenaMark(scratch) : 0;
+    size_t sortSize = sizeof(struct VisibleSprite) * numVisible;
+    struct VisibleSprite *sortBuffer = scratch ? arenaAlloc(scratch, sortSize) : NULL;
+    sortBuffer = sortBuffer ? sortBuffer : arenaAlloc(&rc->frameArena, sortSize);
+    if (!sortBuffer) {
+        // the frame arena always has room for a full sprite list, unless the frame filled it already
+        numVisible = 0;
+    } else {
+        radixSortSprites(visibleSprites, sortBuffer, numVisible);
+    }
+    if (scratch) {
+        arenaRelease(scratch, scratchMark);
+    }
+    rc->numVisibleSprites = numVisible;
+    return numVisible;
+}
+
+void drawSprites(struct Raycaster *rc, int firstColumn, int lastColumn) {
+    const struct SpriteList *list = &rc->world->sprites;
+    // far to near, so closer sprites overwrite farther ones
+    for (int i = 0; i < rc->numVisibleSprites; ++i) {
+        const struct VisibleSprite *visible = &rc->visibleSprites[i];
+        const struct Sprite *sprite = &list->sprites[visible->spriteIndex];
+        if (rc->renderMode == RENDER_MODE_INDEXED) {
+            drawSpriteIndexed(rc, visible, rc->world->indexedSpriteTextures[sprite->texture], firstColumn,
+                              lastColumn);
+        } else {
+            drawSprite(rc, visible, rc->world->spriteTextures[sprite->texture], firstColumn, lastColumn);
+        }
+    }
+}
+
+int renderSprites(struct Raycaster *rc, const int *candidates, int numCandidates) {
+    int numVisible = prepareSprites(rc, candidates, numCandidates);
+    drawSprites(rc, 0, rc->width);
+    return numVisible;
+}
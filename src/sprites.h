@@ -0,0 +1,55 @@
+#ifndef RAYCASTING_SPRITES_H
+#define RAYCASTING_SPRITES_H
+
+#include <stdint.h>
+
+#include "constants.h"
+
+struct Sprite {
+    float x;
+    float y;
+    float velocityX; // only used by dynamic sprites
+    float velocityY;
+    int texture;
+    int isDynamic;
+};
+
+struct SpriteList {
+    int numSprites;
+    struct Sprite sprites[MAX_SPRITES];
+};
+
+// a sprite that survived culling, in screen space
+struct VisibleSprite {
+    uint32_t sortKey;
+    int spriteIndex;
+    float depth;
+    int screenX;
+    int size;
+};
+
+struct Raycaster;
+
+int addSprite(struct SpriteList *list, float x, float y, int texture, int isDynamic);
+
+// Removes a sprite by moving the last one into its slot, returns the old index of the moved sprite.
+// Only the list is updated, remove sprites of a world with worldRemoveSprite().
+int removeSprite(struct SpriteList *list, int index);
+
+// Gathers the sprites that may be visible from the camera of the context: the ones in the cells of
+// the PVS of the camera cell inside the view cone when the world has a complete set for it,
+// otherwise the ones in the cells crossed by the rays of the frame.
+int findVisibleSprites(struct Raycaster *rc);
+
+// Culls, sorts and draws the candidate sprites of the world into the color buffer of the context,
+// or its index buffer in RENDER_MODE_INDEXED.
+// Sprite columns behind a wall of the z-buffer are skipped. Returns the number of sprites drawn.
+int renderSprites(struct Raycaster *rc, const int *candidates, int numCandidates);
+
+// The two halves of renderSprites(): culling and sorting once per frame, then drawing,
+// possibly split in column ranges [firstColumn, lastColumn) drawn in parallel.
+int prepareSprites(struct Raycaster *rc, const int *candidates, int numCandidates);
+
+void drawSprites(struct Raycaster *rc, int firstColumn, int lastColumn);
+
+#endif //RAYCASTING_SPRITES_H
@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "threadpool.h"
+
+struct ThreadPool {
+    int numThreads;
+    pthread_t *workers; // numThreads - 1, the caller is the last thread
+    pthread_mutex_t mutex;
+    pthread_cond_t hasWork;
+    pthread_cond_t isDone;
+
+    // current batch, guarded by mutex
+    ThreadPoolJob job;
+    void *context;
+    int numJobs;
+    int nextJob;
+    int numFinished;
+    unsigned batch; // bumped for every batch, wakes up the workers
+    int isShuttingDown;
+
+    // background task of threadPoolRunAsync(), its thread is started on first use
+    pthread_t asyncThread;
+    int hasAsyncThread;
+    pthread_mutex_t asyncMutex;
+    pthread_cond_t asyncChanged;
+    ThreadPoolJob asyncTask; // NULL when idle, guarded by asyncMutex
+    void *asyncContext;
+    int isAsyncShuttingDown;
+};
+
+// claims and runs jobs of the current batch until none is left, called with the mutex held
+static void runJobs(struct ThreadPool *pool) {
+    while (pool->nextJob < pool->numJobs) {
+        int jobIndex = pool->nextJob++;
+        ThreadPoolJob job = pool->job;
+        void *context = pool->context;
+        pthread_mutex_unlock(&pool->mutex);
+        job(context, jobIndex);
+        pthread_mutex_lock(&pool->mutex);
+        if (++pool->numFinished == pool->numJobs) {
+            pthread_cond_broadcast(&pool->isDone);
+        }
+    }
+}
+
+static void *workerMain(void *argument) {
+    struct ThreadPool *pool = argument;
+    unsigned lastBatch = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->isShuttingDown && pool->batch == lastBatch) {
+            pthread_cond_wait(&pool->hasWork, &pool->mutex);
+        }
+        if (pool->isShuttingDown) {
+            break;
+        }
+        lastBatch = pool->batch;
+        runJobs(pool);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static void *asyncMain(void *argument) {
+    struct ThreadPool *pool = argument;
+    pthread_mutex_lock(&pool->asyncMutex);
+    for (;;) {
+        while (!pool->isAsyncShuttingDown && !pool->asyncTask) {
+            pthread_cond_wait(&pool->asyncChanged, &pool->asyncMutex);
+        }
+        if (!pool->asyncTask) {
+            break;
+        }
+        ThreadPoolJob task = pool->asyncTask;
+        void *context = pool->asyncContext;
+        pthread_mutex_unlock(&pool->asyncMutex);
+        task(context, 0);
+        pthread_mutex_lock(&pool->asyncMutex);
+        pool->asyncTask = NULL;
+        pthread_cond_broadcast(&pool->asyncChanged);
+    }
+    pthread_mutex_unlock(&pool->asyncMutex);
+    return NULL;
+}
+
+struct ThreadPool *createThreadPool(int numThreads) {
+    if (numThreads <= 0) {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = numCpus > 0 ? (int) numCpus : 1;
+    }
+    struct ThreadPool *pool = calloc(1, sizeof(struct ThreadPool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->workers = malloc(sizeof(pthread_t) * numThreads);
+    if (!pool->workers) {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->hasWork, NULL);
+    pthread_cond_init(&pool->isDone, NULL);
+    pthread_mutex_init(&pool->asyncMutex, NULL);
+    pthread_cond_init(&pool->asyncChanged, NULL);
+
+    pool->numThreads = 1;
+    for (int i = 0; i < numThreads - 1; ++i) {
+        if (pthread_create(&pool->workers[i], NULL, workerMain, pool) != 0) {
+            // run with the threads we got
+            break;
+        }
+        pool->numThreads++;
+    }
+    return pool;
+}
+
+void destroyThreadPool(struct ThreadPool *pool) {
+    if (!pool) {
+        return;
+    }
+    // the task in flight may still need the workers
+    if (pool->hasAsyncThread) {
+        pthread_mutex_lock(&pool->asyncMutex);
+        pool->isAsyncShuttingDown = TRUE;
+        pthread_cond_broadcast(&pool->asyncChanged);
+        pthread_mutex_unlock(&pool->asyncMutex);
+        pthread_join(pool->asyncThread, NULL);
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->isShuttingDown = TRUE;
+    pthread_cond_broadcast(&pool->hasWork);
+    pthread_mutex_unlock(&pool->mutex);
+    for (int i = 0; i < pool->numThreads - 1; ++i) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    pthread_cond_destroy(&pool->asyncChanged);
+    pthread_mutex_destroy(&pool->asyncMutex);
+    pthread_cond_destroy(&pool->isDone);
+    pthread_cond_destroy(&pool->hasWork);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->workers);
+    free(pool);
+}
+
+int threadPoolSize(const struct ThreadPool *pool) {
+    return pool->numThreads;
+}
+
+void threadPoolRun(struct ThreadPool *pool, ThreadPoolJob job, void *context, int numJobs) {
+    if (numJobs <= 0) {
+        return;
+    }
+    if (pool->numThreads == 1 || numJobs == 1) {
+        for (int i = 0; i < numJobs; ++i) {
+            job(context, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = job;
+    pool->context = context;
+    pool->numJobs = numJobs;
+    pool->nextJob = 0;
+    pool->numFinished = 0;
+    pool->batch++;
+    pthread_cond_broadcast(&pool->hasWork);
+
+    runJobs(pool);
+    while (pool->numFinished < pool->numJobs) {
+        pthread_cond_wait(&pool->isDone, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void threadPoolRunAsync(struct ThreadPool *pool, ThreadPoolJob task, void *context) {
+    threadPoolWaitAsync(pool);
+    if (!pool->hasAsyncThread) {
+        if (pthread_create(&pool->asyncThread, NULL, asyncMain, pool) != 0) {
+            // no thread to spare, run it right here
+            task(context, 0);
+            return;
+        }
+        pool->hasAsyncThread = TRUE;
+    }
+    pthread_mutex_lock(&pool->asyncMutex);
+    pool->asyncTask = task;
+    pool->asyncContext = context;
+    pthread_cond_broadcast(&pool->asyncChanged);
+    pthread_mutex_unlock(&pool->asyncMutex);
+}
+
+void threadPoolWaitAsync(struct ThreadPool *pool) {
+    pthread_mutex_lock(&pool->asyncMutex);
+    while (pool->asyncTask) {
+        pthread_cond_wait(&pool->asyncChanged, &pool->asyncMutex);
+    }
+    pthread_mutex_unlock(&pool->asyncMutex);
+}
@@ -0,0 +1,28 @@
+#ifndef RAYCASTING_THREADPOOL_H
+#define RAYCASTING_THREADPOOL_H
+
+typedef void (*ThreadPoolJob)(void *context, int jobIndex);
+
+// Fixed set of worker threads running parallel-for style batches of jobs.
+// The calling thread takes jobs too, so a pool of one thread runs everything inline.
+struct ThreadPool;
+
+// numThreads counts the calling thread, 0 picks one thread per online CPU
+struct ThreadPool *createThreadPool(int numThreads);
+
+void destroyThreadPool(struct ThreadPool *pool);
+
+int threadPoolSize(const struct ThreadPool *pool);
+
+// Runs job(context, i) for every i in [0, numJobs) across the pool and returns once all are done.
+void threadPoolRun(struct ThreadPool *pool, ThreadPoolJob job, void *context, int numJobs);
+
+// Runs task(context, 0) on a background thread of the pool and returns right away; the task may
+// run batches with threadPoolRun() itself, the calling thread must not while it is in flight.
+// At most one task is in flight, a new one first waits for the previous one.
+void threadPoolRunAsync(struct ThreadPool *pool, ThreadPoolJob task, void *context);
+
+// Waits for the task of threadPoolRunAsync(), if any, to be done.
+void threadPoolWaitAsync(struct ThreadPool *pool);
+
+#endif //RAYCASTING_THREADPOOL_H
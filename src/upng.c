@@ -32,7 +32,7 @@ freely, subject to the following restrictions:
 #include "upng.h"
 
 #define MAKE_BYTE(b) ((b) & 0xFF)
-#define MAKE_DWORD(a,b,c,d) ((MAKE_BYTE(a) << 24) | (MAKE_BYTE(b) << 16) | (MAKE_BYTE(c) << 8) | MAKE_BYTE(d))
+#define MAKE_DWORD(a,b,c,d) (((unsigned)MAKE_BYTE(a) << 24) | ((unsigned)MAKE_BYTE(b) << 16) | ((unsigned)MAKE_BYTE(c) << 8) | (unsigned)MAKE_BYTE(d))
 #define MAKE_DWORD_PTR(p) MAKE_DWORD((p)[0], (p)[1], (p)[2], (p)[3])
 
 #define CHUNK_IHDR MAKE_DWORD('I','H','D','R')
@@ -52,6 +52,8 @@ freely, subject to the following restrictions:
 #define CODE_LENGTH_BITLEN 7
 #define MAX_BIT_LENGTH 15 /* largest bitlen used by any tree type */
 
+#define MAX_DEFLATE_RATIO 1032 /* a 258 byte copy per two bits is the most a deflate stream expands */
+
 #define DEFLATE_CODE_BUFFER_SIZE (NUM_DEFLATE_CODE_SYMBOLS * 2)
 #define DISTANCE_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
 #define CODE_LENGTH_BUFFER_SIZE (NUM_DISTANCE_SYMBOLS * 2)
@@ -183,6 +185,12 @@ static unsigned char read_bit(unsigned long *bitpointer, const unsigned char *bi
 	return result;
 }
 
+/* whether nbits more bits can be read from a stream of inlength bytes */
+static int has_bits(unsigned long bitpointer, unsigned long nbits, unsigned long inlength)
+{
+	return nbits <= inlength * 8 && bitpointer <= inlength * 8 - nbits;
+}
+
 static unsigned read_bits(unsigned long *bitpointer, const unsigned char *bitstream, unsigned long nbits)
 {
 	unsigned result = 0, i;
@@ -204,7 +212,7 @@ static void huffman_tree_init(huffman_tree* tree, unsigned* buffer, unsigned num
 static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const unsigned *bitlen)
 {
 	unsigned tree1d[MAX_SYMBOLS];
-	unsigned blcount[MAX_BIT_LENGTH];
+	unsigned blcount[MAX_BIT_LENGTH+1];
 	unsigned nextcode[MAX_BIT_LENGTH+1];
 	unsigned bits, n, i;
 	unsigned nodefilled = 0;	/*up to which node it is filled */
@@ -218,6 +226,8 @@ static void huffman_tree_create_lengths(upng_t* upng, huffman_tree* tree, const
 	for (bits = 0; bits < tree->numcodes; bits++) {
 		blcount[bitlen[bits]]++;
 	}
+	/* unused symbols have no code */
+	blcount[0] = 0;
 
 	/*step 2: generate the nextcode values */
 	for (bits = 1; bits <= tree->maxbitlen; bits++) {
@@ -274,7 +284,7 @@ static unsigned huffman_decode_symbol(upng_t *upng, const unsigned char *in, uns
 	unsigned char bit;
 	for (;;) {
 		/* error: end of input memory reached without endcode */
-		if (((*bp) & 0x07) == 0 && ((*bp) >> 3) > inlength) {
+		if (((*bp) & 0x07) == 0 && ((*bp) >> 3) >= inlength) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
 			return 0;
 		}
@@ -304,7 +314,7 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 
 	/*make sure that length values that aren't filled in will be 0, or a wrong tree will be generated */
 	/*C-code note: use no "return" between ctor and dtor of an uivector! */
-	if ((*bp) >> 3 >= inlength - 2) {
+	if (!has_bits(*bp, 14, inlength)) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -318,6 +328,11 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 	hdist = read_bits(bp, in, 5) + 1;	/*number of distance codes. Unlike the spec, the value 1 is added to it here already */
 	hclen = read_bits(bp, in, 4) + 4;	/*number of code length codes. Unlike the spec, the value 4 is added to it here already */
 
+	if (!has_bits(*bp, hclen * 3, inlength)) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return;
+	}
+
 	for (i = 0; i < NUM_CODE_LENGTH_CODES; i++) {
 		if (i < hclen) {
 			codelengthcode[CLCL[i]] = read_bits(bp, in, 3);
@@ -352,11 +367,11 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 			unsigned replength = 3;	/*read in the 2 bits that indicate repeat length (3-6) */
 			unsigned value;	/*set value to the previous code */
 
-			if ((*bp) >> 3 >= inlength) {
+			/*error, bit pointer jumps past memory, or there is no previous length */
+			if (!has_bits(*bp, 2, inlength) || i == 0) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
-			/*error, bit pointer jumps past memory */
 			replength += read_bits(bp, in, 2);
 
 			if ((i - 1) < hlit) {
@@ -382,12 +397,11 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 			}
 		} else if (code == 17) {	/*repeat "0" 3-10 times */
 			unsigned replength = 3;	/*read in the bits that indicate repeat length */
-			if ((*bp) >> 3 >= inlength) {
+			/*error, bit pointer jumps past memory */
+			if (!has_bits(*bp, 3, inlength)) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
-
-			/*error, bit pointer jumps past memory */
 			replength += read_bits(bp, in, 3);
 
 			/*repeat this value in the next lengths */
@@ -408,11 +422,10 @@ static void get_tree_inflate_dynamic(upng_t* upng, huffman_tree* codetree, huffm
 		} else if (code == 18) {	/*repeat "0" 11-138 times */
 			unsigned replength = 11;	/*read in the bits that indicate repeat length */
 			/* error, bit pointer jumps past memory */
-			if ((*bp) >> 3 >= inlength) {
+			if (!has_bits(*bp, 7, inlength)) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				break;
 			}
-
 			replength += read_bits(bp, in, 7);
 
 			/*repeat this value in the next lengths */
@@ -472,6 +485,9 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 		huffman_tree_init(&codetreeD, codetreeD_buffer, NUM_DISTANCE_SYMBOLS, DISTANCE_BITLEN);
 		huffman_tree_init(&codelengthcodetree, codelengthcodetree_buffer, NUM_CODE_LENGTH_CODES, CODE_LENGTH_BITLEN);
 		get_tree_inflate_dynamic(upng, &codetree, &codetreeD, &codelengthcodetree, in, bp, inlength);
+		if (upng->error != UPNG_EOK) {
+			return;
+		}
 	}
 
 	while (done == 0) {
@@ -502,7 +518,7 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 			numextrabits = LENGTH_EXTRA[code - FIRST_LENGTH_CODE_INDEX];
 
 			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
+			if (!has_bits(*bp, numextrabits, inlength)) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
@@ -526,7 +542,7 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 			numextrabitsD = DISTANCE_EXTRA[codeD];
 
 			/* error, bit pointer will jump past memory */
-			if (((*bp) >> 3) >= inlength) {
+			if (!has_bits(*bp, numextrabitsD, inlength)) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
@@ -535,9 +551,15 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 
 			/*part 5: fill in all the out[n] values based on the length and dist */
 			start = (*pos);
+
+			/* error, distance points before the start of the output */
+			if (distance > start) {
+				SET_ERROR(upng, UPNG_EMALFORMED);
+				return;
+			}
 			backward = start - distance;
 
-			if ((*pos) + length >= outsize) {
+			if (length > outsize - (*pos)) {
 				SET_ERROR(upng, UPNG_EMALFORMED);
 				return;
 			}
@@ -550,6 +572,10 @@ static void inflate_huffman(upng_t* upng, unsigned char* out, unsigned long outs
 					backward = start - distance;
 				}
 			}
+		} else {
+			/* length codes 286 and 287 are never used */
+			SET_ERROR(upng, UPNG_EMALFORMED);
+			return;
 		}
 	}
 }
@@ -566,7 +592,7 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
 	p = (*bp) / 8;		/*byte position */
 
 	/* read len (2 bytes) and nlen (2 bytes) */
-	if (p >= inlength - 4) {
+	if (p > inlength || inlength - p < 4) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -582,13 +608,13 @@ static void inflate_uncompressed(upng_t* upng, unsigned char* out, unsigned long
 		return;
 	}
 
-	if ((*pos) + len >= outsize) {
+	if (len > outsize - (*pos)) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
 
 	/* read the literal data: len bytes are now stored in the out buffer */
-	if (p + len > inlength) {
+	if (len > inlength - p) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
@@ -611,24 +637,25 @@ static upng_error uz_inflate_data(upng_t* upng, unsigned char* out, unsigned lon
 	while (done == 0) {
 		unsigned btype;
 
-		/* ensure next bit doesn't point past the end of the buffer */
-		if ((bp >> 3) >= insize) {
+		/* ensure the block header doesn't point past the end of the buffer, which starts at inpos */
+		if (!has_bits(bp, 3, insize - inpos)) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
 			return upng->error;
 		}
 
-		/* read block control bits */
+		/* read block control bits, in separate statements: the order of two reads in one expression is unspecified */
 		done = read_bit(&bp, &in[inpos]);
-		btype = read_bit(&bp, &in[inpos]) | (read_bit(&bp, &in[inpos]) << 1);
+		btype = read_bit(&bp, &in[inpos]);
+		btype |= read_bit(&bp, &in[inpos]) << 1;
 
 		/* process control type appropriateyly */
 		if (btype == 3) {
 			SET_ERROR(upng, UPNG_EMALFORMED);
 			return upng->error;
 		} else if (btype == 0) {
-			inflate_uncompressed(upng, out, outsize, &in[inpos], &bp, &pos, insize);	/*no compression */
+			inflate_uncompressed(upng, out, outsize, &in[inpos], &bp, &pos, insize - inpos);	/*no compression */
 		} else {
-			inflate_huffman(upng, out, outsize, &in[inpos], &bp, &pos, insize, btype);	/*compression, btype 01 or 10 */
+			inflate_huffman(upng, out, outsize, &in[inpos], &bp, &pos, insize - inpos, btype);	/*compression, btype 01 or 10 */
 		}
 
 		/* stop if an error has occured */
@@ -637,6 +664,11 @@ static upng_error uz_inflate_data(upng_t* upng, unsigned char* out, unsigned lon
 		}
 	}
 
+	/* the image data must fill every scanline */
+	if (pos != outsize) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+	}
+
 	return upng->error;
 }
 
@@ -764,7 +796,7 @@ static void unfilter(upng_t* upng, unsigned char *out, const unsigned char *in,
 	unsigned char *prevline = 0;
 
 	unsigned long bytewidth = (bpp + 7) / 8;	/*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise */
-	unsigned long linebytes = (w * bpp + 7) / 8;
+	unsigned long linebytes = ((unsigned long)w * bpp + 7) / 8;
 
 	for (y = 0; y < h; y++) {
 		unsigned long outindex = linebytes * y;
@@ -813,18 +845,21 @@ static void post_process_scanlines(upng_t* upng, unsigned char *out, unsigned ch
 	unsigned bpp = upng_get_bpp(info_png);
 	unsigned w = info_png->width;
 	unsigned h = info_png->height;
+	unsigned long linebits = (unsigned long)w * bpp;
 
 	if (bpp == 0) {
 		SET_ERROR(upng, UPNG_EMALFORMED);
 		return;
 	}
 
-	if (bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8) {
+	if (bpp < 8 && linebits != ((linebits + 7) / 8) * 8) {
 		unfilter(upng, in, in, w, h, bpp);
 		if (upng->error != UPNG_EOK) {
 			return;
 		}
-		remove_padding_bits(out, in, w * bpp, ((w * bpp + 7) / 8) * 8, h);
+		/* the bits past the last pixel are never written, clear them */
+		out[(linebits * h + 7) / 8 - 1] = 0;
+		remove_padding_bits(out, in, linebits, ((linebits + 7) / 8) * 8, h);
 	} else {
 		unfilter(upng, out, in, w, h, bpp);	/*we can immediatly filter into the out buffer, no other steps needed */
 	}
@@ -931,6 +966,12 @@ upng_error upng_header(upng_t* upng)
 	upng->color_depth = upng->source.buffer[24];
 	upng->color_type = (upng_color)upng->source.buffer[25];
 
+	/* the spec limits both dimensions to 2^31 - 1, and an empty image has no scanlines to decode */
+	if (upng->width == 0 || upng->height == 0 || upng->width > INT_MAX || upng->height > INT_MAX) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return upng->error;
+	}
+
 	/* determine our color format */
 	upng->format = determine_format(upng);
 	if (upng->format == UPNG_BADFORMAT) {
@@ -967,7 +1008,7 @@ upng_error upng_decode(upng_t* upng)
 	unsigned char* compressed;
 	unsigned char* inflated;
 	unsigned long compressed_size = 0, compressed_index = 0;
-	unsigned long inflated_size;
+	unsigned long inflated_size, linebits;
 	upng_error error;
 
 	/* if we have an error state, bail now */
@@ -993,6 +1034,13 @@ upng_error upng_decode(upng_t* upng)
 		upng->size = 0;
 	}
 
+	/* the scanlines and the image must be addressable: bail before the size computations below overflow */
+	linebits = (unsigned long)upng->width * upng_get_bpp(upng);
+	if (upng->width > (ULONG_MAX - 7) / upng_get_bpp(upng) || upng->height > (ULONG_MAX - 7) / linebits || (linebits + 7) / 8 + 1 > ULONG_MAX / upng->height) {
+		SET_ERROR(upng, UPNG_ENOMEM);
+		return upng->error;
+	}
+
 	/* first byte of the first chunk after the header */
 	chunk = upng->source.buffer + 33;
 
@@ -1037,6 +1085,13 @@ upng_error upng_decode(upng_t* upng)
 		chunk += upng_chunk_length(chunk) + 12;
 	}
 
+	/* one filter type byte in front of every scanline; bail before allocating the image if the data cannot fill it */
+	inflated_size = ((linebits + 7) / 8 + 1) * upng->height;
+	if (inflated_size / MAX_DEFLATE_RATIO > compressed_size) {
+		SET_ERROR(upng, UPNG_EMALFORMED);
+		return upng->error;
+	}
+
 	/* allocate enough space for the (compressed and filtered) image data */
 	compressed = (unsigned char*)malloc(compressed_size);
 	if (compressed == NULL) {
@@ -1066,7 +1121,6 @@ upng_error upng_decode(upng_t* upng)
 	}
 
 	/* allocate space to store inflated (but still filtered) data */
-	inflated_size = ((upng->width * (upng->height * upng_get_bpp(upng) + 7)) / 8) + upng->height;
 	inflated = (unsigned char*)malloc(inflated_size);
 	if (inflated == NULL) {
 		free(compressed);
@@ -1086,7 +1140,7 @@ upng_error upng_decode(upng_t* upng)
 	free(compressed);
 
 	/* allocate final image buffer */
-	upng->size = (upng->height * upng->width * upng_get_bpp(upng) + 7) / 8;
+	upng->size = (linebits * upng->height + 7) / 8;
 	upng->buffer = (unsigned char*)malloc(upng->size);
 	if (upng->buffer == NULL) {
 		free(inflated);
@@ -1179,6 +1233,11 @@ upng_t* upng_new_from_file(const char *filename)
 	fseek(file, 0, SEEK_END);
 	size = ftell(file);
 	rewind(file);
+	if (size < 0) {
+		fclose(file);
+		SET_ERROR(upng, UPNG_ENOTFOUND);
+		return upng;
+	}
 
 	/* read contents of the file into the vector */
 	buffer = (unsigned char *)malloc((unsigned long)size);
@@ -1187,7 +1246,8 @@ upng_t* upng_new_from_file(const char *filename)
 		SET_ERROR(upng, UPNG_ENOMEM);
 		return upng;
 	}
-	fread(buffer, 1, (unsigned long)size, file);
+	/* a short read leaves a truncated source, which the decoder rejects */
+	size = (long)fread(buffer, 1, (unsigned long)size, file);
 	fclose(file);
 
 	/* set the read buffer as our source buffer, with owning flag set */
@@ -0,0 +1,28 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "upng.h"
+
+// libFuzzer target of the PNG decoder: every input is decoded from memory, and the whole output
+// buffer is read back so AddressSanitizer sees a size that does not match the allocation.
+// Built by clang only, as upng_fuzz; the build seeds upng_corpus/ with the images of images/.
+//
+// usage: upng_fuzz [libFuzzer options] upng_corpus
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    upng_t *upng = upng_new_from_bytes(data, (unsigned long) size);
+    if (!upng) {
+        return 0;
+    }
+    if (upng_decode(upng) == UPNG_EOK) {
+        const unsigned char *buffer = upng_get_buffer(upng);
+        unsigned bufferSize = upng_get_size(upng);
+        volatile unsigned char sink = 0;
+        for (unsigned i = 0; i < bufferSize; ++i) {
+            sink ^= buffer[i];
+        }
+        (void) sink;
+    }
+    upng_free(upng);
+    return 0;
+}
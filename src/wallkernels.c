@@ -0,0 +1,85 @@
+#include "wallkernels.h"
+
+// smallest and largest texture sizes with a specialized kernel, as log2 of the width
+#define MIN_KERNEL_SHIFT 5
+#define MAX_KERNEL_SHIFT 8
+#define NUM_KERNEL_SIZES (MAX_KERNEL_SHIFT - MIN_KERNEL_SHIFT + 1)
+
+#define SHADE_ARGB_NONE(texel, column) (texel)
+#define SHADE_ARGB_LIGHT(texel, column) shadeColor(texel, (column)->shade)
+#define SHADE_INDEXED_NONE(texel, column) (texel)
+#define SHADE_INDEXED_LIGHT(texel, column) (column)->colormap[texel]
+
+// Any texture size: a float division per pixel and a multiply to address the texel.
+#define DEFINE_GENERIC_WALL_KERNEL(name, Pixel, SHADE)                                                  \
+    static void name(const struct WallColumn *column) {                                                 \
+        const Pixel *texels = (const Pixel *) column->texels + column->textureX;                        \
+        Pixel *pixel = (Pixel *) column->pixels + column->pitch * column->top;                          \
+        for (int y = column->top; y < column->bottom; ++y, pixel += column->pitch) {                    \
+            int distanceFromTop = y + column->stripHeight / 2 - column->height / 2;                     \
+            int textureY = distanceFromTop * ((float) column->textureHeight / column->stripHeight);     \
+            Pixel texel = texels[column->textureWidth * textureY];                                      \
+            *pixel = SHADE(texel, column);                                                              \
+        }                                                                                               \
+    }
+
+// Square power of two textures of 1 << SHIFT texels: 16.16 fixed point stepping down the texture,
+// like the sprites, and a mask and a shift to address the texel.
+#define DEFINE_WALL_KERNEL(name, Pixel, SHIFT, SHADE)                                                   \
+    static void name(const struct WallColumn *column) {                                                 \
+        const Pixel *texels = (const Pixel *) column->texels + column->textureX;                        \
+        Pixel *pixel = (Pixel *) column->pixels + column->pitch * column->top;                          \
+        int textureStep = (1 << (SHIFT + 16)) / column->stripHeight;                                    \
+        int textureY = (column->top + column->stripHeight / 2 - column->height / 2) * textureStep;      \
+        for (int y = column->top; y < column->bottom; ++y, pixel += column->pitch) {                    \
+            Pixel texel = texels[((textureY >> 16) & ((1 << SHIFT) - 1)) << SHIFT];                     \
+            *pixel = SHADE(texel, column);                                                              \
+            textureY += textureStep;                                                                    \
+        }                                                                                               \
+    }
+
+// the four formats and shadings of a texture size
+#define DEFINE_WALL_KERNELS(SHIFT)                                                                      \
+    DEFINE_WALL_KERNEL(wallArgb##SHIFT, uint32_t, SHIFT, SHADE_ARGB_NONE)                               \
+    DEFINE_WALL_KERNEL(wallArgbLight##SHIFT, uint32_t, SHIFT, SHADE_ARGB_LIGHT)                         \
+    DEFINE_WALL_KERNEL(wallIndexed##SHIFT, uint8_t, SHIFT, SHADE_INDEXED_NONE)                          \
+    DEFINE_WALL_KERNEL(wallIndexedLight##SHIFT, uint8_t, SHIFT, SHADE_INDEXED_LIGHT)
+
+#define WALL_KERNELS(SHIFT) {                                                                           \
+        {wallArgb##SHIFT, wallArgbLight##SHIFT},                                                        \
+        {wallIndexed##SHIFT, wallIndexedLight##SHIFT}                                                   \
+    }
+
+DEFINE_GENERIC_WALL_KERNEL(wallArgbGeneric, uint32_t, SHADE_ARGB_NONE)
+DEFINE_GENERIC_WALL_KERNEL(wallArgbLightGeneric, uint32_t, SHADE_ARGB_LIGHT)
+DEFINE_GENERIC_WALL_KERNEL(wallIndexedGeneric, uint8_t, SHADE_INDEXED_NONE)
+DEFINE_GENERIC_WALL_KERNEL(wallIndexedLightGeneric, uint8_t, SHADE_INDEXED_LIGHT)
+
+DEFINE_WALL_KERNELS(5)
+DEFINE_WALL_KERNELS(6)
+DEFINE_WALL_KERNELS(7)
+DEFINE_WALL_KERNELS(8)
+
+// [size][format][shading], the generic kernels first
+static const WallKernel wallKernels[NUM_KERNEL_SIZES + 1][NUM_WALL_FORMATS][NUM_WALL_SHADES] = {
+        {
+                {wallArgbGeneric, wallArgbLightGeneric},
+                {wallIndexedGeneric, wallIndexedLightGeneric}
+        },
+        WALL_KERNELS(5),
+        WALL_KERNELS(6),
+        WALL_KERNELS(7),
+        WALL_KERNELS(8)
+};
+
+WallKernel selectWallKernel(int textureWidth, int textureHeight, int format, int shading, int isGeneric) {
+    int size = 0;
+    if (!isGeneric && textureWidth == textureHeight) {
+        for (int shift = MIN_KERNEL_SHIFT; shift <= MAX_KERNEL_SHIFT; ++shift) {
+            if (textureWidth == 1 << shift) {
+                size = shift - MIN_KERNEL_SHIFT + 1;
+            }
+        }
+    }
+    return wallKernels[size][format][shading];
+}
@@ -0,0 +1,42 @@
+#ifndef RAYCASTING_WALLKERNELS_H
+#define RAYCASTING_WALLKERNELS_H
+
+#include <stdint.h>
+
+#include "world.h"
+
+// pixel formats of the wall kernels
+#define WALL_FORMAT_ARGB8888 0 // uint32_t texels and pixels
+#define WALL_FORMAT_INDEXED8 1 // uint8_t palette indices
+#define NUM_WALL_FORMATS 2
+
+// shading of the wall kernels
+#define WALL_SHADE_NONE 0  // full bright, texels are copied as they are
+#define WALL_SHADE_LIGHT 1 // through the LightShade or the colormap of the column
+#define NUM_WALL_SHADES 2
+
+// One textured wall column: the rows [top, bottom) of a strip of stripHeight pixels centered on a
+// frame of the given height, textured with the column textureX of a row-major texture.
+struct WallColumn {
+    const void *texels;
+    int textureWidth;
+    int textureHeight;
+    int textureX;
+    int stripHeight;
+    int top;
+    int bottom;
+    int height;
+    void *pixels;  // row 0 of the column in the frame buffer
+    int pitch;     // pixels from a row to the next
+    const struct LightShade *shade; // WALL_SHADE_LIGHT, ARGB8888
+    const uint8_t *colormap;        // WALL_SHADE_LIGHT, INDEXED8
+};
+
+typedef void (*WallKernel)(const struct WallColumn *column);
+
+// Looks up the kernel of a texture size, pixel format and shading. Square power of two textures,
+// 32 to 256 texels wide, get kernels with shift and mask addressing and fixed point stepping, any
+// other size the generic one. With isGeneric the generic kernel is returned anyway.
+WallKernel selectWallKernel(int textureWidth, int textureHeight, int format, int shading, int isGeneric);
+
+#endif //RAYCASTING_WALLKERNELS_H
@@ -0,0 +1,248 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "world.h"
+#include "textures.h"
+#include "alignedalloc.h"
+
+static int createTextureAtlas(struct World *world) {
+    // the texture data are byte arrays without any alignment, copy them into one aligned block
+    static const uint8_t *const sources[NUM_TEXTURES] = {
+            REDBRICK_TEXTURE, PURPLESTONE_TEXTURE, MOSSYSTONE_TEXTURE, GRAYSTONE_TEXTURE,
+            COLORSTONE_TEXTURE, BLUESTONE_TEXTURE, WOOD_TEXTURE, EAGLE_TEXTURE
+    };
+    size_t textureSize = sizeof(uint32_t) * TEXTURE_WIDTH * TEXTURE_HEIGHT;
+    world->textureAtlas = allocAligned(textureSize * NUM_TEXTURES);
+    if (!world->textureAtlas) {
+        return FALSE;
+    }
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        uint32_t *texture = world->textureAtlas + TEXTURE_WIDTH * TEXTURE_HEIGHT * i;
+        memcpy(texture, sources[i], textureSize);
+        world->textures[i] = texture;
+    }
+    return TRUE;
+}
+
+static int createSpriteTextures(struct World *world) {
+    // procedural sprite textures, texels with zero alpha are transparent
+    for (int i = 0; i < NUM_SPRITE_TEXTURES; ++i) {
+        world->spriteTextures[i] = allocAligned(sizeof(uint32_t) * TEXTURE_WIDTH * TEXTURE_HEIGHT);
+        if (!world->spriteTextures[i]) {
+            return FALSE;
+        }
+    }
+    for (int x = 0; x < TEXTURE_WIDTH; ++x) {
+        for (int y = 0; y < TEXTURE_HEIGHT; ++y) {
+            // a stone pillar standing on the floor
+            int isPillar = x >= TEXTURE_WIDTH / 4 && x < TEXTURE_WIDTH * 3 / 4 && y >= TEXTURE_HEIGHT / 8;
+            world->spriteTextures[0][(TEXTURE_WIDTH * y) + x] = isPillar
+                                                                ? world->textures[3][(TEXTURE_WIDTH * y) + x]
+                                                                : 0x00000000;
+            // a glowing orb floating in the middle of the cell
+            int dx = x - TEXTURE_WIDTH / 2;
+            int dy = y - TEXTURE_HEIGHT / 2;
+            int radius = TEXTURE_WIDTH / 4;
+            int intensity = 255 - (dx * dx + dy * dy) * 160 / (radius * radius);
+            world->spriteTextures[1][(TEXTURE_WIDTH * y) + x] = dx * dx + dy * dy < radius * radius
+                                                                ? 0xFF000000 | (intensity << 16) | (intensity << 8)
+                                                                : 0x00000000;
+        }
+    }
+    return TRUE;
+}
+
+static void computeTextureLuma(struct World *world) {
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        unsigned sum = 0;
+        for (int t = 0; t < TEXTURE_WIDTH * TEXTURE_HEIGHT; ++t) {
+            uint32_t color = world->textures[i][t];
+            // BT.601 luma in 8 bit fixed point
+            sum += (77 * ((color >> 16) & 0xFF) + 150 * ((color >> 8) & 0xFF) + 29 * (color & 0xFF)) >> 8;
+        }
+        world->textureLuma[i] = sum / (TEXTURE_WIDTH * TEXTURE_HEIGHT);
+    }
+}
+
+static void computeLightShades(struct World *world) {
+    for (int level = 0; level < NUM_LIGHT_LEVELS; ++level) {
+        uint32_t scale = (level + 1) * 256 / NUM_LIGHT_LEVELS;
+        world->shades[level].scale = scale;
+        world->shades[level].fogRedBlue = (FOG_COLOR & 0x00FF00FF) * (256 - scale);
+        world->shades[level].fogGreen = (FOG_COLOR & 0x0000FF00) * (256 - scale);
+    }
+}
+
+static int createIndexedTextures(struct World *world) {
+    static const uint32_t flatColors[] = {CEILING_COLOR, FLOOR_COLOR};
+    const uint32_t *images[NUM_TEXTURES + NUM_SPRITE_TEXTURES + 1];
+    int imageSizes[NUM_TEXTURES + NUM_SPRITE_TEXTURES + 1];
+    int numImages = 0;
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        images[numImages] = world->textures[i];
+        imageSizes[numImages++] = TEXTURE_WIDTH * TEXTURE_HEIGHT;
+    }
+    for (int i = 0; i < NUM_SPRITE_TEXTURES; ++i) {
+        images[numImages] = world->spriteTextures[i];
+        imageSizes[numImages++] = TEXTURE_WIDTH * TEXTURE_HEIGHT;
+    }
+    images[numImages] = flatColors;
+    imageSizes[numImages++] = 2;
+    buildPalette(&world->palette, images, imageSizes, numImages);
+
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        world->indexedTextures[i] = allocAligned(TEXTURE_WIDTH * TEXTURE_HEIGHT);
+        if (!world->indexedTextures[i]) {
+            return FALSE;
+        }
+        quantizeImage(&world->palette, world->textures[i], world->indexedTextures[i], TEXTURE_WIDTH * TEXTURE_HEIGHT);
+    }
+    for (int i = 0; i < NUM_SPRITE_TEXTURES; ++i) {
+        world->indexedSpriteTextures[i] = allocAligned(TEXTURE_WIDTH * TEXTURE_HEIGHT);
+        if (!world->indexedSpriteTextures[i]) {
+            return FALSE;
+        }
+        quantizeImage(&world->palette, world->spriteTextures[i], world->indexedSpriteTextures[i],
+                      TEXTURE_WIDTH * TEXTURE_HEIGHT);
+    }
+    world->ceilingIndex = paletteNearest(&world->palette, CEILING_COLOR);
+    world->floorIndex = paletteNearest(&world->palette, FLOOR_COLOR);
+    return TRUE;
+}
+
+struct World *createWorld(const int *cells, int numCols, int numRows) {
+    struct World *world = calloc(1, sizeof(struct World));
+    if (!world) {
+        return NULL;
+    }
+
+    world->textureWidth = TEXTURE_WIDTH;
+    world->textureHeight = TEXTURE_HEIGHT;
+    if (!createTextureAtlas(world)) {
+        destroyWorld(world);
+        return NULL;
+    }
+    computeTextureLuma(world);
+    computeLightShades(world);
+
+    if (!initMap(&world->map, cells, numCols, numRows) ||
+        !initSpatialGrid(&world->spriteGrid, numCols, numRows, MAX_SPRITES) ||
+        !createSpriteTextures(world) ||
+        !createIndexedTextures(world)) {
+        destroyWorld(world);
+        return NULL;
+    }
+    return world;
+}
+
+void destroyWorld(struct World *world) {
+    if (!world) {
+        return;
+    }
+    for (int i = 0; i < NUM_TEXTURES; ++i) {
+        freeAligned(world->indexedTextures[i]);
+    }
+    for (int i = 0; i < NUM_SPRITE_TEXTURES; ++i) {
+        freeAligned(world->spriteTextures[i]);
+        freeAligned(world->indexedSpriteTextures[i]);
+    }
+    freeAligned(world->textureAtlas);
+    if (world->hasPvs) {
+        freePvs(&world->pvs);
+    }
+    freeSpatialGrid(&world->spriteGrid);
+    freeMap(&world->map);
+    free(world);
+}
+
+int worldLoadPvs(struct World *world, const char *path) {
+    struct Map *map = &world->map;
+    if (world->hasPvs) {
+        freePvs(&world->pvs);
+    }
+    world->hasPvs = loadPvs(&world->pvs, path, map->cells, map->numCols, map->numRows);
+    if (!world->hasPvs) {
+        fprintf(stderr, "%s is missing or stale, building the PVS...\n", path);
+        world->hasPvs = buildPvs(&world->pvs, map->cells, map->numCols, map->numRows);
+    }
+    return world->hasPvs;
+}
+
+int worldAddSprite(struct World *world, float x, float y, int texture, int isDynamic) {
+    int index = addSprite(&world->sprites, x, y, texture, isDynamic);
+    if (index >= 0) {
+        spatialGridInsert(&world->spriteGrid, index, x, y);
+        world->spriteRevision++;
+    }
+    return index;
+}
+
+void worldRemoveSprite(struct World *world, int index) {
+    if (index < 0 || index >= world->sprites.numSprites) {
+        return;
+    }
+    spatialGridRemove(&world->spriteGrid, index);
+    int moved = removeSprite(&world->sprites, index);
+    if (moved != index) {
+        // the grid indexes sprites by slot, relink the moved one under its new slot
+        const struct Sprite *sprite = &world->sprites.sprites[index];
+        spatialGridRemove(&world->spriteGrid, moved);
+        spatialGridInsert(&world->spriteGrid, index, sprite->x, sprite->y);
+    }
+    world->spriteRevision++;
+}
+
+void worldEditCell(struct World *world, int col, int row, int content) {
+    struct Map *map = &world->map;
+    if (col < 0 || col >= map->numCols || row < 0 || row >= map->numRows) {
+        return;
+    }
+    // the cell itself is updated right away, stale PVS sets are rebuilt over the next updates
+    int cell = row * map->numCols + col;
+    int oldContent = map->cells[cell];
+    setMapCell(map, col, row, content);
+    if (world->hasPvs) {
+        invalidatePvs(&world->pvs, cell, oldContent, map->cells[cell]);
+    }
+}
+
+static void updateSprites(struct World *world, float deltaTime) {
+    if (world->areSpritesPaused) {
+        return;
+    }
+    int hasMoved = FALSE;
+    for (int i = 0; i < world->sprites.numSprites; ++i) {
+        struct Sprite *sprite = &world->sprites.sprites[i];
+        if (!sprite->isDynamic || (sprite->velocityX == 0 && sprite->velocityY == 0)) {
+            continue;
+        }
+        hasMoved = TRUE;
+        // bounce off the walls one axis at a time
+        float newX = sprite->x + sprite->velocityX * deltaTime;
+        if (mapHasWallAt(&world->map, newX, sprite->y)) {
+            sprite->velocityX = -sprite->velocityX;
+        } else {
+            sprite->x = newX;
+        }
+        float newY = sprite->y + sprite->velocityY * deltaTime;
+        if (mapHasWallAt(&world->map, sprite->x, newY)) {
+            sprite->velocityY = -sprite->velocityY;
+        } else {
+            sprite->y = newY;
+        }
+        spatialGridMove(&world->spriteGrid, i, sprite->x, sprite->y);
+    }
+    if (hasMoved) {
+        world->spriteRevision++;
+    }
+}
+
+void updateWorld(struct World *world, float deltaTime) {
+    updateDoors(&world->map, deltaTime);
+    updateSprites(world, deltaTime);
+    if (world->hasPvs) {
+        refreshPvs(&world->pvs, world->map.cells, PVS_REFRESH_BUDGET_NS);
+    }
+}
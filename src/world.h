@@ -0,0 +1,72 @@
+#ifndef RAYCASTING_WORLD_H
+#define RAYCASTING_WORLD_H
+
+#include <stdint.h>
+
+#include "constants.h"
+#include "map.h"
+#include "sprites.h"
+#include "spatial.h"
+#include "pvs.h"
+#include "palette.h"
+
+// SWAR shading of an ARGB color: red and blue, then green, are scaled in one multiply each and
+// the fog color is added in, already scaled. scale is in 1/256 units, up to 256.
+struct LightShade {
+    uint32_t scale;
+    uint32_t fogRedBlue;
+    uint32_t fogGreen;
+};
+
+// Everything the views of a scene share: the map, the entities and the assets.
+// Any number of Raycaster contexts can render the same world.
+struct World {
+    struct Map map;
+    struct SpriteList sprites;
+    int spriteRevision; // bumped when a sprite is added or moves, like the map revision
+    int areSpritesPaused; // the dynamic sprites stay put, so a scene with them can go idle
+    struct SpatialGrid spriteGrid;
+    struct Pvs pvs;
+    int hasPvs;
+    const uint32_t *textures[NUM_TEXTURES]; // in the atlas
+    uint32_t *textureAtlas;                 // the wall textures one after the other, aligned
+    int textureWidth;  // size of the wall and sprite textures, in texels
+    int textureHeight;
+    uint8_t textureLuma[NUM_TEXTURES]; // average brightness of every texture, for flat shading
+    struct LightShade shades[NUM_LIGHT_LEVELS];
+    uint32_t *spriteTextures[NUM_SPRITE_TEXTURES];
+
+    // the same assets as palette indices, for RENDER_MODE_INDEXED
+    struct Palette palette;
+    uint8_t *indexedTextures[NUM_TEXTURES];
+    uint8_t *indexedSpriteTextures[NUM_SPRITE_TEXTURES];
+    uint8_t ceilingIndex;
+    uint8_t floorIndex;
+};
+
+static inline uint32_t shadeColor(uint32_t color, const struct LightShade *shade) {
+    uint32_t redBlue = (((color & 0x00FF00FF) * shade->scale + shade->fogRedBlue) >> 8) & 0x00FF00FF;
+    uint32_t green = (((color & 0x0000FF00) * shade->scale + shade->fogGreen) >> 8) & 0x0000FF00;
+    return 0xFF000000 | redBlue | green;
+}
+
+struct World *createWorld(const int *cells, int numCols, int numRows);
+
+void destroyWorld(struct World *world);
+
+// Loads the PVS built offline by pvsbuild, or builds it when the file is missing or stale.
+int worldLoadPvs(struct World *world, const char *path);
+
+int worldAddSprite(struct World *world, float x, float y, int texture, int isDynamic);
+
+// Removes a sprite from the list and the grid. The last sprite takes the index of the removed one.
+void worldRemoveSprite(struct World *world, int index);
+
+// Runtime edit of a map cell, stale PVS sets are rebuilt over the next updates.
+void worldEditCell(struct World *world, int col, int row, int content);
+
+// Animates doors and dynamic sprites, unless paused, and refreshes stale PVS sets. The map and sprite revisions
+// only change when something moved, so an idle world can be detected between updates.
+void updateWorld(struct World *world, float deltaTime);
+
+#endif //RAYCASTING_WORLD_H